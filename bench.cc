@@ -0,0 +1,170 @@
+#include <chrono>
+#include <vector>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_CPU.h"
+#include "std_Rom.h"
+#include "std_Env.h"
+#include "std_Fusion.h"
+
+// Headless throughput benchmark: runs each ROM for a fixed number of 60 Hz
+// frames and reports emulated instructions per second, plain and through
+// cFusion with its hit rates, and the instructions per frame it gets under
+// TIMING_VIP, then times Reset back to the cached boot image
+// and batched cEnv steps with frame-skip, plain and fused.
+//
+//   bench [-n frames] <rom>...
+
+#define BENCH_RESETS	100000
+#define BENCH_ENVS		64
+#define BENCH_ENV_SKIP	4
+
+struct sMachine {
+	sRegister	reg;
+	uint8_t		memory[MEM_SIZE] {};
+	uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+	uint8_t		delay_timer{};
+	uint8_t		sound_timer{};
+};
+
+int main (int argc, char **argv) {
+	int frames = 100000;
+	std::vector<const char*> roms;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			frames = std::atoi(argv[++i]);
+		} else {
+			roms.push_back(argv[i]);
+		}
+	}
+	if (roms.empty()) {
+		nDebug::LogInfo("Usage: bench [-n frames] <rom>...");
+		return -1;
+	}
+
+	double total_seconds = 0;
+	long int total_cycles = 0;
+	double fused_total_seconds = 0;
+	double reset_seconds = 0;
+	int resets = 0;
+	double env_seconds[2] {};
+	long int env_steps = 0;
+	for (const char* rom : roms) {
+		std::vector<uint8_t> image;
+		if (!nRom::Read(rom, image)) {
+			nDebug::LogError(std::string("Unable to open ") + rom);
+			continue;
+		}
+		sMachine* m = new sMachine;
+		cCPU cpu(m->reg, m->memory, m->delay_timer, m->sound_timer, m->frame_buffer);
+		cpu.Seed(1);
+		cpu.Boot(image.data(), image.size());
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f) {
+			cpu.RunFrame();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printf("%-50s %10ld instr %8.3f s %8.2f MIPS\n", rom, cpu.GetCycle(), seconds, cpu.GetCycle() / seconds / 1e6);
+		total_seconds += seconds;
+		total_cycles += cpu.GetCycle();
+
+		// Same run through the fused handlers, which must end where the plain
+		// core did.
+		sMachine* fm = new sMachine;
+		cCPU fcpu(fm->reg, fm->memory, fm->delay_timer, fm->sound_timer, fm->frame_buffer);
+		fcpu.Seed(1);
+		fcpu.Boot(image.data(), image.size());
+		cFusion* fusion = new cFusion(fcpu);
+		const auto fused_start = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f) {
+			fusion->RunFrame();
+		}
+		const double fused_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fused_start).count();
+		const bool same = fcpu.GetCycle() == cpu.GetCycle() && fm->reg.PC == m->reg.PC && fm->reg.I == m->reg.I
+						  && !std::memcmp(fm->reg.V, m->reg.V, sizeof fm->reg.V)
+						  && !std::memcmp(fm->memory, m->memory, MEM_SIZE)
+						  && !std::memcmp(fm->frame_buffer, m->frame_buffer, sizeof fm->frame_buffer);
+		char kinds[160] = "";
+		for (int k = FUSE_FONT_DRAW; k < FUSE_KINDS; ++k) {
+			const size_t len = std::strlen(kinds);
+			snprintf(kinds + len, sizeof kinds - len, "  %s %.1f%%", cFusion::Name(k),
+					 100.0 * fusion->Covered(k) / fcpu.GetCycle());
+		}
+		printf("  fused %8.2f MIPS x%5.2f, %5.1f%% of instructions fused:%s  %s\n", fcpu.GetCycle() / fused_seconds / 1e6,
+			   seconds / fused_seconds, 100.0 * fusion->Covered() / fcpu.GetCycle(), kinds, same ? "match" : "MISMATCH");
+		fused_total_seconds += fused_seconds;
+		delete fusion;
+		delete fm;
+
+		// Under VIP timing the ROM's own instruction mix sets its speed.
+		sMachine* vm = new sMachine;
+		cCPU vcpu(vm->reg, vm->memory, vm->delay_timer, vm->sound_timer, vm->frame_buffer);
+		vcpu.Seed(1);
+		vcpu.SetTiming(TIMING_VIP);
+		vcpu.SetTimerPeriod(VIP_CYCLES_PER_FRAME);
+		vcpu.Boot(image.data(), image.size());
+		long int vip_instructions = 0;
+		const auto vip_start = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f) {
+			const long int end = vcpu.GetCycle() - vcpu.GetCycle() % VIP_CYCLES_PER_FRAME + VIP_CYCLES_PER_FRAME;
+			while (vcpu.GetCycle() < end && vcpu.GetState()) {
+				vcpu.Run();
+				vip_instructions++;
+			}
+			vcpu.LatchInputs();
+		}
+		const double vip_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - vip_start).count();
+		printf("  vip   %8.2f MIPS, %6.1f instructions per frame\n", vip_instructions / vip_seconds / 1e6,
+			   (double) vip_instructions / frames);
+		delete vm;
+
+		const auto reset_start = std::chrono::steady_clock::now();
+		for (int i = 0; i < BENCH_RESETS; ++i) {
+			cpu.Reset();
+			cpu.Run();
+		}
+		reset_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - reset_start).count();
+		resets += BENCH_RESETS;
+		delete m;
+
+		// Batched env steps, plain and fused, with the same key sequence.
+		const int batches = frames / BENCH_ENV_SKIP / BENCH_ENVS;
+		for (int fused = 0; fused < 2; ++fused) {
+			std::vector<cEnv> envs(BENCH_ENVS);
+			cEnv* handles[BENCH_ENVS];
+			uint16_t actions[BENCH_ENVS];
+			float rewards[BENCH_ENVS];
+			uint8_t dones[BENCH_ENVS];
+			for (int i = 0; i < BENCH_ENVS; ++i) {
+				handles[i] = &envs[i];
+				envs[i].Load(image.data(), image.size());
+				envs[i].Reset(i + 1);
+				envs[i].SetFusion(fused);
+			}
+			uint32_t keys = 0x2545F491;
+			const auto env_start = std::chrono::steady_clock::now();
+			for (int b = 0; b < batches; ++b) {
+				for (int i = 0; i < BENCH_ENVS; ++i) {
+					keys ^= keys << 13;
+					keys ^= keys >> 17;
+					keys ^= keys << 5;
+					actions[i] = 1 << (keys & 15);
+				}
+				cEnv::StepBatch(handles, BENCH_ENVS, actions, BENCH_ENV_SKIP, rewards, dones, nullptr);
+			}
+			env_seconds[fused] += std::chrono::duration<double>(std::chrono::steady_clock::now() - env_start).count();
+		}
+		env_steps += (long int) batches * BENCH_ENVS;
+	}
+	printf("%-50s %10ld instr %8.3f s %8.2f MIPS\n", "total", total_cycles, total_seconds, total_cycles / total_seconds / 1e6);
+	printf("%-50s %10ld instr %8.3f s %8.2f MIPS x%5.2f\n", "total fused", total_cycles, fused_total_seconds,
+		   total_cycles / fused_total_seconds / 1e6, total_seconds / fused_total_seconds);
+	printf("%-50s %10d      %8.3f s %8.0f per second\n", "reset", resets, reset_seconds, resets / reset_seconds);
+	printf("%-50s %10ld      %8.3f s %8.0f per second (%d envs, skip %d)\n", "env step", env_steps, env_seconds[0],
+		   env_steps / env_seconds[0], BENCH_ENVS, BENCH_ENV_SKIP);
+	printf("%-50s %10ld      %8.3f s %8.0f per second x%5.2f\n", "env step fused", env_steps, env_seconds[1],
+		   env_steps / env_seconds[1], env_seconds[0] / env_seconds[1]);
+	return 0;
+}
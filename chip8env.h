@@ -0,0 +1,66 @@
+#pragma once
+
+#ifndef Chip8EnvCommon
+#define Chip8EnvCommon
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Public C interface to libchip8env.a (make env). Usable from C and C++ and
+// from anything that can call C; it pulls in nothing else from the tree.
+
+#define CHIP8_ENV_WIDTH		64
+#define CHIP8_ENV_HEIGHT	32
+
+// Environments are opaque handles from chip8_env_create.
+#ifdef __cplusplus
+class cEnv;
+typedef cEnv chip8_env;
+#else
+typedef struct cEnv chip8_env;
+#endif
+
+// What a reward hook gets to look at after each step.
+typedef struct sEnvView {
+	const uint8_t*	memory;
+	const uint8_t*	frame_buffer;	// CHIP8_ENV_WIDTH * CHIP8_ENV_HEIGHT, one byte per pixel
+	const uint8_t*	V;
+	uint16_t		PC;
+	uint16_t		I;
+	uint8_t			delay_timer;
+	uint8_t			sound_timer;
+	uint8_t			done;
+} sEnvView;
+
+typedef float (*tRewardHook) (const sEnvView* view, void* user);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+chip8_env* chip8_env_create (const uint8_t* rom, size_t size);
+void chip8_env_destroy (chip8_env* env);
+
+// Instructions per emulated frame; the default matches the emulator.
+void chip8_env_set_budget (chip8_env* env, int instructions_per_frame);
+// Non-zero runs frames through the fused interpreter; same results.
+void chip8_env_set_fusion (chip8_env* env, int on);
+// hook may be null to go back to a reward of 0.
+void chip8_env_set_reward (chip8_env* env, tRewardHook hook, void* user);
+void chip8_env_reset (chip8_env* env, uint32_t seed);
+
+// Holds action (bit n for key n) for frames frames and returns the reward.
+// observation, if not null, receives CHIP8_ENV_WIDTH * CHIP8_ENV_HEIGHT
+// bytes; done, if not null, is set once the core has stopped.
+float chip8_env_step (chip8_env* env, uint16_t action, int frames, uint8_t* observation, uint8_t* done);
+// n environments, one action each. rewards and dones are n long;
+// observations, when not null, receives n consecutive frames.
+void chip8_env_step_batch (chip8_env* const* envs, int n, const uint16_t* actions, int frames,
+						   float* rewards, uint8_t* dones, uint8_t* observations);
+const uint8_t* chip8_env_observation (chip8_env* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
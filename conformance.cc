@@ -0,0 +1,190 @@
+#include <thread>
+#include <fstream>
+#include <vector>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_CPU.h"
+#include "std_Rom.h"
+
+// Golden-frame conformance runner. Every case in the script runs a ROM
+// headless with scripted key events and compares FNV-1a hashes of
+// frame_buffer at the listed frames. Cases run in parallel, one thread each.
+//
+//   rom <path>                  starts a case
+//   seed <n>                    Cxnn seed (default 1)
+//   key <frame> <hex key> <0|1> key event applied before <frame> runs
+//   check <frame> <hash>|?      expected frame_buffer hash after <frame>
+
+struct sKeyEvent {
+	int		frame{};
+	uint8_t	key{};
+	bool	down{};
+};
+
+struct sCheck {
+	int			frame{};
+	uint64_t	expected{};
+	bool		known = false;
+	uint64_t	actual{};
+};
+
+struct sCase {
+	std::string				rom;
+	uint32_t				seed = 1;
+	std::vector<sKeyEvent>	keys;
+	std::vector<sCheck>		checks;
+	bool					loaded = false;
+};
+
+struct sMachine {
+	sRegister	reg;
+	uint8_t		memory[MEM_SIZE] {};
+	uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+	uint8_t		delay_timer{};
+	uint8_t		sound_timer{};
+};
+
+void RunCase (sCase &c) {
+	sMachine* m = new sMachine;
+	std::vector<uint8_t> image;
+	c.loaded = nRom::Read(c.rom.c_str(), image);
+	if (c.loaded) {
+		cCPU cpu(m->reg, m->memory, m->delay_timer, m->sound_timer, m->frame_buffer);
+		cpu.Seed(c.seed);
+		cpu.Boot(image.data(), image.size());
+
+		size_t next_key = 0;
+		int frame = 0;
+		for (sCheck &check : c.checks) {
+			for (; frame < check.frame; ++frame) {
+				for (; next_key < c.keys.size() && c.keys[next_key].frame <= frame; ++next_key) {
+					cpu.SetKey(c.keys[next_key].key, c.keys[next_key].down);
+				}
+				cpu.RunFrame();
+			}
+			check.actual = nHash::Fnv1a(m->frame_buffer, sizeof m->frame_buffer);
+		}
+	}
+	delete m;
+}
+
+bool ParseScript (const char* path, std::vector<sCase> &cases) {
+	std::ifstream in(path);
+	if (!in) {
+		return false;
+	}
+	std::string line;
+	while (std::getline(in, line)) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string cmd;
+		if (!(fields >> cmd)) {
+			continue;
+		}
+		if (cmd == "rom") {
+			cases.emplace_back();
+			std::getline(fields >> std::ws, cases.back().rom);
+			continue;
+		}
+		if (cases.empty()) {
+			nDebug::LogError("'" + cmd + "' before the first 'rom' line");
+			return false;
+		}
+		sCase &c = cases.back();
+		if (cmd == "seed") {
+			fields >> c.seed;
+		} else if (cmd == "key") {
+			sKeyEvent e;
+			int key, down;
+			fields >> e.frame >> std::hex >> key >> std::dec >> down;
+			e.key = key;
+			e.down = down;
+			c.keys.push_back(e);
+		} else if (cmd == "check") {
+			sCheck check;
+			std::string hash;
+			fields >> check.frame >> hash;
+			check.known = (hash != "?");
+			check.expected = check.known ? std::stoull(hash, nullptr, 16) : 0;
+			c.checks.push_back(check);
+		} else {
+			nDebug::LogError("Unknown directive '" + cmd + "'");
+			return false;
+		}
+	}
+	for (sCase &c : cases) {
+		std::stable_sort(c.keys.begin(), c.keys.end(), [](const sKeyEvent &a, const sKeyEvent &b) { return a.frame < b.frame; });
+		std::stable_sort(c.checks.begin(), c.checks.end(), [](const sCheck &a, const sCheck &b) { return a.frame < b.frame; });
+	}
+	return true;
+}
+
+void WriteScript (const char* path, const std::vector<sCase> &cases) {
+	FILE* out = fopen(path, "w");
+	if (!out) {
+		nDebug::LogError("Unable to rewrite the golden file");
+		return;
+	}
+	fprintf(out, "# Golden frame hashes; regenerate with ./conformance %s --update\n", path);
+	for (const sCase &c : cases) {
+		fprintf(out, "\nrom %s\n", c.rom.c_str());
+		if (c.seed != 1) {
+			fprintf(out, "seed %u\n", c.seed);
+		}
+		for (const sKeyEvent &e : c.keys) {
+			fprintf(out, "key %d %X %d\n", e.frame, e.key, e.down);
+		}
+		for (const sCheck &check : c.checks) {
+			fprintf(out, "check %d %016llx\n", check.frame, (unsigned long long) check.actual);
+		}
+	}
+	fclose(out);
+}
+
+int main (int argc, char **argv) {
+	if (argc < 2) {
+		nDebug::LogInfo("Usage: conformance <golden file> [--update]");
+		return -1;
+	}
+	const bool update = argc > 2 && std::strcmp(argv[2], "--update") == 0;
+
+	std::vector<sCase> cases;
+	if (!ParseScript(argv[1], cases)) {
+		nDebug::LogError("Unable to read the golden file");
+		return -1;
+	}
+
+	std::vector<std::thread> workers;
+	for (sCase &c : cases) {
+		workers.emplace_back(RunCase, std::ref(c));
+	}
+	for (std::thread &w : workers) {
+		w.join();
+	}
+
+	int failures = 0;
+	for (const sCase &c : cases) {
+		bool ok = c.loaded;
+		for (const sCheck &check : c.checks) {
+			if (check.known && check.actual != check.expected && !update) {
+				printf("FAIL %s @ frame %d: expected %016llx, got %016llx\n", c.rom.c_str(), check.frame,
+					   (unsigned long long) check.expected, (unsigned long long) check.actual);
+				ok = false;
+			}
+		}
+		if (!c.loaded) {
+			printf("FAIL %s: unable to open ROM\n", c.rom.c_str());
+		} else if (ok) {
+			printf("ok   %s (%zu checkpoints)\n", c.rom.c_str(), c.checks.size());
+		}
+		failures += !ok;
+	}
+
+	if (update) {
+		WriteScript(argv[1], cases);
+		printf("Updated %s\n", argv[1]);
+		return 0;
+	}
+	printf("%zu cases, %d failed\n", cases.size(), failures);
+	return failures ? 1 : 0;
+}
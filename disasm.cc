@@ -0,0 +1,96 @@
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_Disasm.h"
+#include "std_FlowGraph.h"
+
+uint8_t memory[MEM_SIZE] {0};
+
+size_t LoadImage (const char* rom_name, uint8_t* memory) {
+	FILE *rom = fopen(rom_name, "rb");
+	if (!rom) {
+		return 0;
+	}
+	const size_t rom_size = fread(&memory[ROM_ENTRYPOINT], 1, MEM_SIZE - ROM_ENTRYPOINT, rom);
+	fclose(rom);
+	return rom_size;
+}
+
+void PrintListing (const cFlowAnalyzer &flow, uint16_t end) {
+	for (uint16_t addr = ROM_ENTRYPOINT; addr < end; ) {
+		const uint8_t f = flow.flags[addr];
+		if (f & FLOW_INSTR) {
+			if (f & FLOW_CALL) {
+				printf("\nsub_%03X:\n", addr);
+			} else if (f & FLOW_LEADER) {
+				printf("L%03X:\n", addr);
+			}
+			const uint16_t instr = (memory[addr] << 8) | memory[addr + 1];
+			if (flow.IsSelfModified(addr) || flow.IsSelfModified(addr + 1)) {
+				printf("    %03X: %04X  %-20s; self-modified\n", addr, instr, nDisasm::Disassemble(sOpcode(instr)).c_str());
+			} else {
+				printf("    %03X: %04X  %s\n", addr, instr, nDisasm::Disassemble(sOpcode(instr)).c_str());
+			}
+			addr += 2;
+		} else {
+			char bits[9] {};
+			for (int j = 0; j < 8; ++j) {
+				bits[j] = (memory[addr] & (0x80 >> j)) ? '#' : '.';
+			}
+			printf("    %03X: %02X    DB   0x%02X           ; %s%s\n", addr, memory[addr], memory[addr], bits,
+				   (f & FLOW_WRITTEN) ? " written" : "");
+			addr += 1;
+		}
+	}
+}
+
+void PrintDot (const cFlowAnalyzer &flow) {
+	printf("digraph chip8 {\n\tnode [shape=box fontname=monospace];\n");
+	for (const sBlock &blk : flow.blocks) {
+		printf("\tb%03X [label=\"", blk.start);
+		for (uint16_t pc = blk.start; pc < blk.end; pc += 2) {
+			const uint16_t instr = (memory[pc] << 8) | memory[pc + 1];
+			printf("%03X: %s\\l", pc, nDisasm::Disassemble(sOpcode(instr)).c_str());
+		}
+		printf("\"];\n");
+		for (int i = 0; i < blk.succ_count; ++i) {
+			const char* style = (blk.calls && i == 0) ? " [style=dashed]" : "";
+			printf("\tb%03X -> b%03X%s;\n", blk.start, blk.succ[i], style);
+		}
+	}
+	printf("}\n");
+}
+
+int main (int argc, char **argv) {
+	if (argc < 2) {
+		nDebug::LogInfo("Usage: disasm <rom_name> [--dot]");
+		return -1;
+	}
+
+	const size_t rom_size = LoadImage(argv[1], memory);
+	if (rom_size == 0) {
+		nDebug::LogError("Error: Unable to open ROM file");
+		return -1;
+	}
+	const uint16_t end = ROM_ENTRYPOINT + rom_size;
+
+	cFlowAnalyzer flow;
+	flow.Analyze(memory, ROM_ENTRYPOINT, end);
+
+	if (argc > 2 && std::strcmp(argv[2], "--dot") == 0) {
+		PrintDot(flow);
+		return 0;
+	}
+
+	PrintListing(flow, end);
+
+	int self_modified = 0;
+	for (uint16_t addr = ROM_ENTRYPOINT; addr < end; ++addr) {
+		self_modified += flow.IsSelfModified(addr);
+	}
+	printf("\n; %zu bytes, %d code, %zu data, %zu blocks\n", rom_size, flow.CodeBytes(),
+		   rom_size - flow.CodeBytes(), flow.blocks.size());
+	printf("; %d self-modified code bytes, %d stores through unknown I, %d jumps out of the image\n",
+		   self_modified, flow.unknown_stores, flow.external_targets);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_Env.h"
+#include "chip8env.h"
+
+// C interface to cEnv, built into libchip8env.a (make env) so agents can
+// drive the core from other languages without SDL. The prototypes are in
+// chip8env.h; nothing below allocates except create.
+
+extern "C" {
+
+	chip8_env* chip8_env_create (const uint8_t* rom, size_t size) {
+		chip8_env* env = new cEnv;
+		env->Load(rom, size);
+		return env;
+	}
+
+	void chip8_env_destroy (chip8_env* env) {
+		delete env;
+	}
+
+	void chip8_env_set_budget (chip8_env* env, int instructions_per_frame) {
+		env->SetBudget(instructions_per_frame);
+	}
+
+	void chip8_env_set_fusion (chip8_env* env, int on) {
+		env->SetFusion(on != 0);
+	}
+
+	void chip8_env_set_reward (chip8_env* env, tRewardHook hook, void* user) {
+		env->SetReward(hook, user);
+	}
+
+	void chip8_env_reset (chip8_env* env, uint32_t seed) {
+		env->Reset(seed);
+	}
+
+	float chip8_env_step (chip8_env* env, uint16_t action, int frames, uint8_t* observation, uint8_t* done) {
+		const float reward = env->Step(action, frames);
+		if (observation) {
+			std::memcpy(observation, env->Observation(), DISP_WIDTH * DISP_HEIGHT);
+		}
+		if (done) {
+			*done = env->Done();
+		}
+		return reward;
+	}
+
+	void chip8_env_step_batch (chip8_env* const* envs, int n, const uint16_t* actions, int frames,
+							   float* rewards, uint8_t* dones, uint8_t* observations) {
+		cEnv::StepBatch(envs, n, actions, frames, rewards, dones, observations);
+	}
+
+	const uint8_t* chip8_env_observation (chip8_env* env) {
+		return env->Observation();
+	}
+
+}
@@ -0,0 +1,331 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_CPU.h"
+#include "std_Debugger.h"
+#include "std_Disasm.h"
+#include "std_Fusion.h"
+
+// Differential fuzzer. Each case turns the input bytes into a random machine
+// state with the bytes themselves as the instruction stream at PC, then runs
+// the reference core and every alternative core in lockstep and reports the
+// first instruction after which any of them disagrees.
+//
+// Standalone: fuzz [seconds] [threads] | fuzz --replay <file>
+// libFuzzer:  build with -fsanitize=fuzzer -DCHIP8_LIBFUZZER
+
+#define FUZZ_STEPS		32
+#define FUZZ_MAX_INPUT	64
+
+// Instruction sequences the fusion core recognizes. Random bytes almost
+// never line them up, so the standalone fuzzer splices some into its inputs:
+// the bits in fixed come from word, the rest stay random, and the first
+// shared words get the same X.
+struct sIdiom {
+	uint16_t	word[3];
+	uint16_t	fixed[3];
+	int			shared;
+};
+const sIdiom idioms[] = {
+	{{0x6000, 0xF029, 0xD000}, {0xF000, 0xF0FF, 0xF000}, 2},
+	{{0xF033, 0xF065, 0x0000}, {0xF0FF, 0xF0FF, 0x0000}, 0},
+	{{0x7001, 0x3000, 0x1000}, {0xF0FF, 0xF000, 0xF000}, 2},
+	{{0x3000, 0x1000, 0x0000}, {0xF000, 0xF000, 0x0000}, 0},
+	{{0xE09E, 0x1000, 0x0000}, {0xF0FF, 0xF000, 0x0000}, 0},
+	{{0x1FF0, 0x0000, 0x0000}, {0xFFFF, 0x0000, 0x0000}, 0},
+	{{0xF00A, 0x0000, 0x0000}, {0xF0FF, 0x0000, 0x0000}, 0},
+	{{0xF007, 0x3000, 0x1FF4}, {0xF0FF, 0xF0FF, 0xFFFF}, 2},
+	{{0xF007, 0x4000, 0x1FF4}, {0xF0FF, 0xF000, 0xFFFF}, 2},
+};
+
+struct sMachine {
+	sRegister	reg;
+	uint8_t		memory[MEM_SIZE] {};
+	uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+	uint8_t		delay_timer{};
+	uint8_t		sound_timer{};
+	cCPU		cpu;
+	cDebugger	dbg;
+	cFusion		fusion;
+
+	sMachine () : cpu(reg, memory, delay_timer, sound_timer, frame_buffer), dbg(cpu, reg, memory), fusion(cpu) {};
+};
+
+// step returns how many instructions it ran; the reference core then runs
+// as many before the two are compared.
+struct sCore {
+	const char*	name;
+	int			(*step)(sMachine &m);
+};
+
+// cores[0] is the reference every other entry is checked against.
+const sCore cores[] = {
+	{"reference", [](sMachine &m) { m.cpu.Run(); return 1; }},
+	{"debugger",  [](sMachine &m) { m.dbg.Step(); return 1; }},
+	{"fusion",    [](sMachine &m) { return m.fusion.Step(FUZZ_STEPS); }},
+};
+const int core_count = sizeof cores / sizeof cores[0];
+
+struct sRng {
+	uint64_t s;
+
+	uint64_t Next () {
+		uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+void BuildCase (const uint8_t* data, size_t size, sSnapshot &snap, uint8_t &quirks) {
+	sRng rng {nHash::Fnv1a(data, size)};
+	size = std::min<size_t>(size, FUZZ_MAX_INPUT);
+
+	for (int i = 0; i < MEM_SIZE; i += 8) {
+		const uint64_t r = rng.Next();
+		std::memcpy(&snap.memory[i], &r, 8);
+	}
+	for (int i = 0; i < DISP_WIDTH * DISP_HEIGHT; ++i) {
+		snap.frame_buffer[i] = (rng.Next() & 7) == 0;
+	}
+	for (int i = 0; i < 0x10; ++i) {
+		snap.reg.V[i] = rng.Next();
+	}
+	snap.reg.I = rng.Next() % MEM_SIZE;
+	snap.reg.PC = ROM_ENTRYPOINT + 2 * (rng.Next() % ((MEM_SIZE - ROM_ENTRYPOINT - FUZZ_MAX_INPUT) / 2));
+	std::memcpy(&snap.memory[snap.reg.PC], data, size);
+	// 1FFn in the input jumps n bytes back from itself, so idioms that loop
+	// on themselves can be spliced without knowing where the input lands.
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		const uint16_t addr = snap.reg.PC + i;
+		if (snap.memory[addr] == 0x1F && (snap.memory[addr + 1] & 0xF0) == 0xF0) {
+			const uint16_t target = addr - (snap.memory[addr + 1] & 0x0F);
+			snap.memory[addr] = 0x10 | target >> 8;
+			snap.memory[addr + 1] = target & 0xFF;
+		}
+	}
+
+	snap.stack_depth = rng.Next() % 13;
+	for (int i = 0; i < 12; ++i) {
+		snap.stack[i] = rng.Next() & 0xFFE;
+	}
+	// A quarter of the cases start with no key down, so Fx0A waits.
+	const uint64_t keys = (rng.Next() & 3) ? rng.Next() : 0;
+	for (int i = 0; i < 16; ++i) {
+		snap.keypad[i] = (keys >> i) & 1;
+	}
+	snap.delay_timer = rng.Next();
+	snap.sound_timer = rng.Next();
+	snap.tapped = snap.pending_release = 0;
+	snap.rng_state = rng.Next() | 1;
+	snap.cycle = 0;
+	snap.state = true;
+	snap.fault = FAULT_NONE;
+	// Quirks are settings rather than state; half the cases run with some.
+	quirks = (rng.Next() & 1) ? rng.Next() & (QUIRK_SHIFT_VY | QUIRK_MEMORY_I | QUIRK_JUMP_VX | QUIRK_VF_RESET) : 0;
+}
+
+bool Compare (const sSnapshot &a, const sSnapshot &b, std::string &what) {
+	char buf[96];
+	if (a.reg.PC != b.reg.PC) {
+		snprintf(buf, sizeof buf, "PC %03X vs %03X", a.reg.PC, b.reg.PC);
+	} else if (a.reg.I != b.reg.I) {
+		snprintf(buf, sizeof buf, "I %03X vs %03X", a.reg.I, b.reg.I);
+	} else if (std::memcmp(a.reg.V, b.reg.V, sizeof a.reg.V) != 0) {
+		int i = 0;
+		while (a.reg.V[i] == b.reg.V[i]) {
+			i++;
+		}
+		snprintf(buf, sizeof buf, "V%X %02X vs %02X", i, a.reg.V[i], b.reg.V[i]);
+	} else if (a.stack_depth != b.stack_depth || std::memcmp(a.stack, b.stack, a.stack_depth * sizeof a.stack[0]) != 0) {
+		snprintf(buf, sizeof buf, "stack (depth %d vs %d)", a.stack_depth, b.stack_depth);
+	} else if (a.fault != b.fault || a.state != b.state) {
+		snprintf(buf, sizeof buf, "fault %d vs %d", a.fault, b.fault);
+	} else if (std::memcmp(a.memory, b.memory, sizeof a.memory) != 0) {
+		int i = 0;
+		while (a.memory[i] == b.memory[i]) {
+			i++;
+		}
+		snprintf(buf, sizeof buf, "memory[%03X] %02X vs %02X", i, a.memory[i], b.memory[i]);
+	} else if (std::memcmp(a.frame_buffer, b.frame_buffer, sizeof a.frame_buffer) != 0) {
+		snprintf(buf, sizeof buf, "frame_buffer");
+	} else if (a.delay_timer != b.delay_timer || a.sound_timer != b.sound_timer) {
+		snprintf(buf, sizeof buf, "timers");
+	} else if (a.rng_state != b.rng_state) {
+		snprintf(buf, sizeof buf, "random state");
+	} else if (a.cycle != b.cycle) {
+		snprintf(buf, sizeof buf, "cycle %ld vs %ld", a.cycle, b.cycle);
+	} else {
+		return true;
+	}
+	what = buf;
+	return false;
+}
+
+struct sWorkspace {
+	sSnapshot	start;
+	sSnapshot	expect;
+	sSnapshot	actual;
+	uint8_t		quirks{};
+	sMachine	ref;
+	sMachine	alt;
+};
+
+// Returns false and fills report on the first divergence.
+bool RunCase (sWorkspace &w, const uint8_t* data, size_t size, std::string &report) {
+	BuildCase(data, size, w.start, w.quirks);
+	w.ref.cpu.SetQuirks(w.quirks);
+	w.alt.cpu.SetQuirks(w.quirks);
+
+	for (int c = 1; c < core_count; ++c) {
+		w.ref.cpu.LoadState(w.start);
+		w.alt.cpu.LoadState(w.start);
+		for (int step = 0; step < FUZZ_STEPS; ) {
+			const uint16_t pc = w.ref.reg.PC & MEM_MASK;
+			const uint16_t instr = (w.ref.memory[pc] << 8) | w.ref.memory[(pc + 1) & MEM_MASK];
+
+			const int ran = cores[c].step(w.alt);
+			for (int i = 0; i < ran; ++i) {
+				cores[0].step(w.ref);
+			}
+			w.ref.cpu.SaveState(w.expect);
+			w.alt.cpu.SaveState(w.actual);
+
+			std::string what;
+			if (!Compare(w.expect, w.actual, what)) {
+				char buf[176];
+				snprintf(buf, sizeof buf, "%s diverges from %s at step %d, %03X: %04X %s, quirks %X\n  %s (reference vs %s)\n",
+						 cores[c].name, cores[0].name, step, pc, instr, nDisasm::Disassemble(sOpcode(instr)).c_str(),
+						 w.quirks, what.c_str(), cores[c].name);
+				report = buf;
+				return false;
+			}
+			step += ran;
+		}
+	}
+	return true;
+}
+
+#ifdef CHIP8_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t* data, size_t size) {
+	static sWorkspace* w = new sWorkspace;
+	std::string report;
+	if (!RunCase(*w, data, size, report)) {
+		fputs(report.c_str(), stderr);
+		abort();
+	}
+	return 0;
+}
+
+#else
+
+std::atomic<uint64_t>	total_cases {0};
+std::atomic<bool>		diverged {false};
+std::mutex				report_lock;
+std::string				first_report;
+std::string				first_input;
+
+void Worker (uint64_t seed, double seconds) {
+	sWorkspace* w = new sWorkspace;
+	sRng rng {seed};
+	uint8_t data[FUZZ_MAX_INPUT];
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+	uint64_t local = 0;
+
+	while (!diverged.load(std::memory_order_relaxed)) {
+		const size_t size = 2 + rng.Next() % (FUZZ_MAX_INPUT - 1);
+		for (size_t i = 0; i < size; ++i) {
+			data[i] = rng.Next();
+		}
+		for (size_t at = 0; at + 6 <= size && (rng.Next() & 1); at += 2 * (1 + rng.Next() % 4)) {
+			const sIdiom &idiom = idioms[rng.Next() % (sizeof idioms / sizeof idioms[0])];
+			const uint16_t x = rng.Next() & 0x0F00;
+			for (int k = 0; k < 3 && idiom.fixed[k]; ++k) {
+				uint16_t word = ((data[at + 2 * k] << 8 | data[at + 2 * k + 1]) & ~idiom.fixed[k]) | idiom.word[k];
+				if (k < idiom.shared) {
+					word = (word & 0xF0FF) | x;
+				}
+				data[at + 2 * k] = word >> 8;
+				data[at + 2 * k + 1] = word & 0xFF;
+			}
+		}
+		std::string report;
+		if (!RunCase(*w, data, size, report)) {
+			std::lock_guard<std::mutex> guard(report_lock);
+			if (!diverged.exchange(true)) {
+				first_report = report;
+				first_input.assign((const char*) data, size);
+			}
+			break;
+		}
+		if ((++local & 1023) == 0) {
+			total_cases += 1024;
+			if (std::chrono::steady_clock::now() > deadline) {
+				break;
+			}
+		}
+	}
+	total_cases += local & 1023;
+	delete w;
+}
+
+int main (int argc, char **argv) {
+	if (argc > 2 && std::strcmp(argv[1], "--replay") == 0) {
+		FILE* f = fopen(argv[2], "rb");
+		if (!f) {
+			nDebug::LogError("Unable to open replay input");
+			return -1;
+		}
+		uint8_t data[FUZZ_MAX_INPUT];
+		const size_t size = fread(data, 1, sizeof data, f);
+		fclose(f);
+		sWorkspace* w = new sWorkspace;
+		std::string report;
+		const bool ok = RunCase(*w, data, size, report);
+		printf("%s", ok ? "no divergence\n" : report.c_str());
+		delete w;
+		return ok ? 0 : 1;
+	}
+
+	char* end = nullptr;
+	const double seconds = (argc > 1) ? std::strtod(argv[1], &end) : 10.0;
+	const bool seconds_ok = argc <= 1 || (*argv[1] && *end == '\0' && seconds > 0);
+	const long threads = (argc > 2) ? std::strtol(argv[2], &end, 10) : std::max(1u, std::thread::hardware_concurrency());
+	const bool threads_ok = argc <= 2 || (*argv[2] && *end == '\0' && threads > 0 && threads <= 1024);
+	if (argc > 3 || !seconds_ok || !threads_ok) {
+		nDebug::LogInfo("Usage: fuzz [seconds] [threads] | fuzz --replay <file>");
+		return -1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; ++i) {
+		workers.emplace_back(Worker, (uint64_t) time(nullptr) * 7919 + i, seconds);
+	}
+	for (std::thread &t : workers) {
+		t.join();
+	}
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%llu cases on %ld threads in %.1f s (%.0f cases/min), %d cores compared\n",
+		   (unsigned long long) total_cases.load(), threads, elapsed, total_cases.load() / elapsed * 60.0, core_count);
+
+	if (diverged) {
+		printf("%s", first_report.c_str());
+		FILE* f = fopen("fuzz-divergence.bin", "wb");
+		if (f) {
+			fwrite(first_input.data(), 1, first_input.size(), f);
+			fclose(f);
+			printf("  input saved to fuzz-divergence.bin (replay with --replay)\n");
+		}
+		return 1;
+	}
+	return 0;
+}
+
+#endif
@@ -1,8 +1,22 @@
+#include <filesystem>
 #include "std_CommonIncludes.h"
 #include "std_Chip8Includes.h"
 #include "std_Display.h"
-
-long int cycle = 0;
+#include "std_CPU.h"
+#include "std_Debugger.h"
+#include "std_Input.h"
+#include "std_Capture.h"
+#include "std_Rom.h"
+#include "std_Config.h"
+#include "std_Remote.h"
+#include "std_Shm.h"
+#include "std_RunAhead.h"
+#include "std_Netplay.h"
+#include "std_Cheat.h"
+#include "std_Coverage.h"
+#include "std_Fusion.h"
+#include "std_Library.h"
+#include "std_Picker.h"
 
 uint8_t	frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
 uint8_t memory[4 * ONE_K] {0};
@@ -12,579 +26,410 @@ uint32_t color_buffer[DISP_HEIGHT * DISP_WIDTH] {};
 uint8_t delay_timer{};
 uint8_t sound_timer{};
 
-bool LoadROM(int argc, char **argv, uint8_t* memory) {
-	if (argc < 2) {
-        nDebug::LogInfo("Usage: <rom_name>");
-		return false;
-    }
+// Path of the ROM that is running, for F5/F6/F7 and the window title.
+std::string rom_path;
+uint64_t rom_hash{};
+// A fault is logged once per run; anything that restarts the core clears it.
+bool fault_reported = false;
+
+cConfig config_layers;
+sConfig config;
+
+// Frame timing derived from the config on every ROM load, so the frame loop
+// walks a ready-made slice table instead of consulting settings.
+struct sFramePlan {
+	int					budget{};		// cycles per frame
+	bool				fused{};		// plain slices go through cFusion
+	std::vector<int>	slice_budget;
+	double				frame_ms{};
+};
+sFramePlan plan;
+cRunAhead runahead;
+cNetplay netplay;
+cCheats cheats(memory);
+cCoverage coverage;
+std::vector<std::string> library_dirs;
+std::string library_cache;
+cLibrary library;
+cPicker picker(library, config_layers);
+
+void ClearColors () {
+	std::fill(std::begin(color_buffer), std::end(color_buffer), config.bg_color);
+}
 
-    const char *rom_name = argv[1];
-    FILE *rom = fopen(rom_name, "rb");
-    if (!rom) {
-        nDebug::LogInfo("Error: Unable to open ROM file");
-		return false;
-    }
+void ApplyConfig (cSDL &sdl_ctl, cInput &input) {
+	nLog::Logger().SetLevel(config.log_level);
+	sdl_ctl.SetLook(config.filter, config.fg_color, config.bg_color, config.lerp_rate);
+	sdl_ctl.SetSize(config.win_width, config.win_height);
+	if (config.bindings.empty()) {
+		input.DefaultBindings();
+	} else if (!input.LoadBindings(config.bindings.c_str())) {
+		nDebug::LogError("Unable to open key bindings file");
+	}
 
-    fseek(rom, 0, SEEK_END);
-    const size_t rom_size = ftell(rom);
-    rewind(rom);
-    fread(&memory[ROM_ENTRYPOINT], 1, rom_size, rom);
-    fclose(rom);
-    nDebug::LogInfo("Successfully loaded ROM!");
+	const int budget = (config.timing == TIMING_VIP) ? VIP_CYCLES_PER_FRAME : config.inst_per_sec / 60;
+	plan.budget = budget;
+	plan.fused = config.fusion && config.timing == TIMING_FLAT;
+	const int slices = std::clamp(config.input_slices, 1, budget);
+	plan.slice_budget.resize(slices);
+	for (int s = 0; s < slices; ++s) {
+		plan.slice_budget[s] = budget * (s + 1) / slices - budget * s / slices;
+	}
+	plan.frame_ms = config.frame_ms;
 
-	return true;
+	std::vector<sCheat> freezes;
+	cheats.Clear();
+	cCheats::ParseList(config.cheats, freezes);
+	for (const sCheat &c : freezes) {
+		cheats.Freeze(c.addr, c.value);
+	}
+	runahead.Configure(config.runahead, budget);
 }
 
-struct sRegister {
-	uint16_t    PC{};
-	uint8_t     V[0x10] {};
-	uint16_t    I{};
+bool SwitchRom (cCPU &cpu, cSDL &sdl_ctl, cInput &input, const std::string &path) {
+	std::vector<uint8_t> image;
+	if (!nRom::Read(path.c_str(), image)) {
+		nDebug::LogError("Unable to open ROM file " + path);
+		return false;
+	}
+	const uint64_t hash = nHash::Fnv1a(image.data(), image.size());
+	config = config_layers.Resolve(hash);
+	ApplyConfig(sdl_ctl, input);
+	cpu.SetTiming(config.timing);
+	cpu.SetQuirks(config.quirks);
+	cpu.SetTimerPeriod(plan.budget);
+	cpu.Boot(image.data(), image.size());
+	// The report reads addresses against the loaded image, so counts from
+	// another ROM would land on the wrong opcodes.
+	if (hash != rom_hash) {
+		coverage.Clear();
+	}
+	ClearColors();
+	fault_reported = false;
+	rom_path = path;
+	rom_hash = hash;
+	sdl_ctl.SetTitle("CHIP-8 Emulator - " + std::filesystem::path(path).filename().string());
+	char section[32];
+	snprintf(section, sizeof section, " [rom %016llx]", (unsigned long long) hash);
+	nDebug::LogInfo("Loaded " + path + section);
+	return true;
+}
 
-	void PrintRegisters () {
-		nDebug::LogValue("PC", PC);
-		nDebug::LogValue("I", I);
-		for (int i = 0; i < 0x10; ++i) {
-			nDebug::LogValue(nDebug::ConvertToString("V[", i, "]"), V[i]);
+// The ROM step places away from the current one among the .ch8 files in its
+// directory, in name order.
+std::string NeighbourRom (int step) {
+	const std::filesystem::path dir = std::filesystem::path(rom_path).parent_path();
+	std::error_code ec;
+	std::vector<std::string> roms;
+	for (const auto &entry : std::filesystem::directory_iterator(dir.empty() ? "." : dir, ec)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".ch8") {
+			roms.push_back(entry.path().string());
 		}
-		nDebug::LogInfo("");
 	}
-};
-
-class cCPU  {
-	private:
-		sRegister*  _reg{};
-		uint8_t*    _mem{};
-		uint8_t*    _delay{};
-		uint8_t*    _sound{};
-		uint8_t*    _disp{};
-		uint16_t    instr{};
-		uint16_t    NNN{};
-		uint8_t     NN{};
-		uint8_t     N{};
-		uint8_t     X{};
-		uint8_t     Y{};
-
-		bool state = true;
-		bool keypad[16]{};
-		bool key_pressed = false;
+	if (roms.empty()) {
+		return rom_path;
+	}
+	std::sort(roms.begin(), roms.end());
+	const std::string current = (dir.empty() ? std::filesystem::path(".") / rom_path : std::filesystem::path(rom_path)).string();
+	const int at = std::find(roms.begin(), roms.end(), current) - roms.begin();
+	const int n = roms.size();
+	return roms[((at + step) % n + n) % n];
+}
 
-		uint16_t 	stack[12];
-    	uint16_t* 	stack_ptr;
+// Opens the picker on the running ROM with the index as it stands and
+// rescans the library directories in the background; PollLibrary brings the
+// result in.
+void OpenPicker () {
+	library.StartScan(library_dirs);
+	picker.Open(rom_path);
+}
 
-		uint8_t X_coord, Y_coord, orig_X, randNum;
-	public:
-		cCPU () {};
+// Once per frame: takes a finished rescan, which only read the ROMs the
+// on-disk index did not already know, and saves the index if it changed.
+void PollLibrary () {
+	if (!library.Poll()) {
+		return;
+	}
+	if (!library.SaveCache(library_cache.c_str())) {
+		nDebug::LogWarn("Unable to write library index " + library_cache);
+	}
+	nDebug::LogInfo("Library: ", library.Size(), " ROMs, ", library.Read(), " read");
+	picker.Refresh();
+}
 
-		cCPU (sRegister &reg, uint8_t* mem, uint8_t &delay, uint8_t &sound, uint8_t* disp) : _reg(&reg), _mem(mem), _delay(&delay), _sound(&sound), _disp(disp) {
-			stack_ptr = stack;
-			srand(time(0));
+// Drains the SDL queue; returns true when the user asked to quit.
+bool HandleEvents (cCPU &cpu, cSDL &sdl_ctl, cDebugger &dbg, cInput &input, cCapture &capture) {
+	bool quit = false;
+	SDL_Event e;
+	while (SDL_PollEvent(&e) != 0) {
+		if (e.type == SDL_QUIT) {
+			quit = true;
 		}
-
-		void InitToRom () {
-			_reg->PC = ROM_ENTRYPOINT;
+		std::string pick;
+		if (picker.HandleEvent(e, pick)) {
+			if (!pick.empty()) {
+				SwitchRom(cpu, sdl_ctl, input, pick);
+			}
+			continue;
 		}
-
-		void LoadFontToMem () {
-			uint8_t font[80] = {
-				0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-				0x20, 0x60, 0x20, 0x20, 0x70, // 1
-				0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-				0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-				0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-				0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-				0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-				0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-				0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-				0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-				0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-				0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-				0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-				0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-				0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-				0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-			};
-
-			for (int i = 0x50; i < 0xA0; ++i) {
-				_mem[i] = font[i - 0x50];
+		if (input.HandleEvent(e, cpu)) {
+			continue;
+		}
+		// Under netplay anything that changes the core outside the rollback
+		// timeline would desync the peers; only quitting and capture are left.
+		const SDL_Keycode sym = (e.type == SDL_KEYDOWN) ? e.key.keysym.sym : 0;
+		if (netplay.Active() && (e.type == SDL_DROPFILE || sym == SDLK_SPACE || sym == SDLK_F1 || sym == SDLK_F2
+								 || sym == SDLK_F5 || sym == SDLK_F6 || sym == SDLK_F7)) {
+			if (e.type == SDL_DROPFILE) {
+				SDL_free(e.drop.file);
 			}
+			nDebug::LogWarn("Not available during netplay");
+			continue;
 		}
-
-		// void DisplayFont () {
-		// 	for (int character = 0; character < 16; character++) {
-		// 		for (int row = 0; row < 5; row++) {
-		// 			unsigned char byte = _mem[0x50 + character * 5 + row];
-		// 			for (int bit = 7; bit >= 4; bit--) {
-		// 				if ((byte >> bit) & 1) {
-		// 					std::cout << "*";
-		// 				} else {
-		// 					std::cout << " ";
-		// 				}
-		// 			}
-		// 			std::cout << "\n";
-		// 		}
-		// 		std::cout << "\n";
-		// 	}
-		// }
-
-		void Fetch () { // BIG_ENDIAN
-			instr = _mem[_reg->PC] << 8;
-			instr |= _mem[_reg->PC + 1];
-			_reg->PC += 2;
+		// Started on a directory, the machine stays held until a ROM is picked.
+		if (rom_path.empty() && (sym == SDLK_SPACE || sym == SDLK_F1 || sym == SDLK_F5 || sym == SDLK_F6 || sym == SDLK_F7)) {
+			nDebug::LogWarn("No ROM loaded; F2 opens the picker");
+			continue;
 		}
-
-		void Decode () {
-			NNN = instr & 0x0FFF;
-			NN = NNN & 0x00FF;
-			N = NN & 0x0F;
-			X = (NNN >> 8) & 0x0F;
-			Y = (NNN >> 4) & 0x0F;
+		if (e.type == SDL_DROPFILE) {
+			SwitchRom(cpu, sdl_ctl, input, e.drop.file);
+			SDL_free(e.drop.file);
 		}
-
-		void Execute () {
-			switch (instr >> 12) {
-				case (0x0):
-					if (NNN == 0x00E0) {
-						#ifdef DEBUG
-							nDebug::LogInfo("Clearing Screen");
-						#endif
-						std::memset(&_disp[0], false, sizeof *_disp);
-						break;
-					}
-					if (NNN == 0x00EE) {
-						#ifdef DEBUG
-							nDebug::LogInfo("Pop from stack");
-						#endif
-						_reg->PC = *--stack_ptr;
-						break;
-					}
-					#ifdef DEBUG
-						nDebug::LogInfo("Operation not implemented");
-						nDebug::LogValue("Instruction", instr);
-					#endif
-					break;
-				case (0x1):
-					#ifdef DEBUG
-						nDebug::LogInfo("Jumping to ", NNN);
-					#endif
-					_reg->PC = NNN;
-					break;
-				case (0x2):
-					#ifdef DEBUG
-						nDebug::LogInfo("Push to stack");
-					#endif
-					*stack_ptr++ = _reg->PC;
-					_reg->PC = NNN;
-					break;
-				case (0x3):
-					#ifdef DEBUG
-						nDebug::LogInfo("If V[", X,"] == ", NN, " skip instruction");
-					#endif
-					if(_reg->V[X] == NN) {
-						_reg->PC += 2;
-					}
-					break;
-				case (0x4):
-					#ifdef DEBUG
-						nDebug::LogInfo("If V[", X,"] != ", NN, " skip instruction");
-					#endif
-					if(_reg->V[X] != NN) {
-						_reg->PC += 2;
-					}
-					break;
-				case (0x5):
-					#ifdef DEBUG
-						nDebug::LogInfo("If V[", X,"] == V[", Y, "] skip instruction");
-					#endif
-					if(_reg->V[X] == _reg->V[Y]) {
-						_reg->PC += 2;
-					}
-					break;
-				case (0x6):
-					#ifdef DEBUG
-						nDebug::LogInfo("Setting V[", X,"] to ", NN);
-					#endif
-					_reg->V[X] = NN;
-					break;
-				case (0x7):
-					#ifdef DEBUG
-						nDebug::LogInfo("Adding ", NN," to V[", X,"]");
-					#endif
-					_reg->V[X] += NN;
-					break;
-				case (0x8):
-					switch (N) {
-						case (0x0):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] = V[", Y,"]");
-							#endif
-							_reg->V[X] = _reg->V[Y];
-							break;
-						case (0x1):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] |= V[", Y,"]");
-							#endif
-							_reg->V[X] |= _reg->V[Y];
-							break;
-						case (0x2):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] &= V[", Y,"]");
-							#endif
-							_reg->V[X] &= _reg->V[Y];
-							break;
-						case (0x3):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] XOR= V[", Y,"]");
-							#endif
-							_reg->V[X] ^= _reg->V[Y];
-							break;
-						case (0x4):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] += V[", Y,"]");
-							#endif
-							_reg->V[X] += _reg->V[Y];
-							if (_reg->V[X] < _reg->V[Y]) {
-								_reg->V[0xF] = 0x1;
-							}
-							break;
-						case (0x5):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] -= V[", Y,"]");
-							#endif
-							_reg->V[X] -= _reg->V[Y];
-							if (_reg->V[X] < _reg->V[Y]) {
-								_reg->V[0xF] = 0x1;
-							} else {
-								_reg->V[0xF] = 0x0;
-							}
-							break;
-						case (0x6):
-							#ifdef DEBUG
-								nDebug::LogInfo("Shift V[", X, "] right by 1. Set VF to LSB before shift.");
-							#endif
-							_reg->V[0xF] = _reg->V[X] & 0x01; // LSB before shift
-							_reg->V[X] >>= 1;
-							break;
-						case (0x7):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set -V[", X,"] -= V[", Y,"]");
-							#endif
-							_reg->V[X] = _reg->V[Y] - _reg->V[X];
-							if (_reg->V[Y] > _reg->V[X]) {
-								_reg->V[0xF] = 0x1;
-							} else {
-								_reg->V[0xF] = 0x0;
-							}
-							break;
-						case (0xE):
-							#ifdef DEBUG
-								nDebug::LogInfo("Shift V[", X, "] left by 1. Set VF to MSB before shift.");
-							#endif
-							_reg->V[0xF] = (_reg->V[X] & 0x80) >> 7; // MSB before shift
-							_reg->V[X] <<= 1;
-							break;
-					}	
-					break;
-				case (0x9):
-					#ifdef DEBUG
-						nDebug::LogInfo("If V[", X,"] != V[", Y, "] skip instruction");
-					#endif
-					if(_reg->V[X] != _reg->V[Y]) {
-						_reg->PC += 2;
-					}
-					break;
-				case (0xA):
-					#ifdef DEBUG
-						nDebug::LogInfo("Settting I to ", NNN);
-					#endif
-					_reg->I = NNN;
-					break;
-				case (0xC):
-					#ifdef DEBUG
-						nDebug::LogInfo("Store random value in V[", X, "] binary ANDed with ", NN);
-					#endif
-					randNum = rand() % 0xFF;
-					randNum &= NN;
-					_reg->V[X] = randNum;
-					break;
-				case (0xD):
-					#ifdef DEBUG
-						nDebug::LogInfo("Drawing sprites");
-					#endif			
-					X_coord = _reg->V[X] % DISP_WIDTH;
-					Y_coord = _reg->V[Y] % DISP_HEIGHT;
-					orig_X = X_coord;
-					_reg->V[0xF] = 0;
-					for (uint8_t i = 0; i < N; i++) {
-						const uint8_t sprite_data = _mem[_reg->I + i];
-						X_coord = orig_X;
-						for (int8_t j = 7; j >= 0; j--) {
-							uint8_t *pixel = &_disp[Y_coord * DISP_WIDTH + X_coord];
-							const bool sprite_bit = (sprite_data & (1 << j));
-							if (sprite_bit && *pixel) {
-								_reg->V[0xF] = 1;
-							}
-							*pixel ^= sprite_bit;
-							if (++X_coord >= DISP_WIDTH)   break;
-						}
-						if (++Y_coord >= DISP_HEIGHT)  break;
-					}
-					break;
-				case (0xE):
-					if (NN == 0x9E) {
-						#ifdef DEBUG
-							nDebug::LogInfo("Skip next instruction if key V[", X, "] is pressed");
-						#endif
-						if (keypad[_reg->V[X]]) {
-							_reg->PC += 2;
-						}
-					} else if (NN == 0xA1) {
-						#ifdef DEBUG
-							nDebug::LogInfo("Skip next instruction if key V[", X, "] is not pressed");
-						#endif
-						if (!keypad[_reg->V[X]]) {
-							_reg->PC += 2;
-						}
-					} else {
-						#ifdef DEBUG
-							nDebug::LogInfo("Operation not implemented");
-							nDebug::LogValue("Instruction", instr);
-						#endif
-					}
-					break;
-				case (0xF):
-					switch (NN) {
-						case (0x1E):
-							#ifdef DEBUG
-								nDebug::LogInfo("Add V[", X,"] to I ", _reg->I);
-							#endif
-							_reg->I += _reg->V[X];
-							if (_reg->I > 0x1000) {
-								_reg->V[0xF] = 0x1;
-							}
-							break;
-						case (0x0A):
-							#ifdef DEBUG
-								nDebug::LogInfo("Wait for key press and store in V[", X, "]");
-							#endif
-							key_pressed = false;							
-							for (int i = 0; i < 16; ++i) {
-								if (keypad[i]) {
-									_reg->V[X] = i;
-									key_pressed = true;
-									#ifdef DEBUG
-										nDebug::LogInfo("Key pressed: ", i);
-									#endif
-									break;
-								}
-							}
-							if (!key_pressed) {
-								_reg->PC -= 2;
-							}
-							break;
-						case (0x07):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set V[", X,"] to delay timer value");
-							#endif
-							_reg->V[X] = *_delay;
-							break;
-						case (0x15):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set delay timer to V[", X,"]");
-							#endif
-							*_delay = _reg->V[X];
-							break;
-						case (0x18):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set sound timer to V[", X,"]");
-							#endif
-							*_sound = _reg->V[X];
-							break;
-						case (0x29):
-							#ifdef DEBUG
-								nDebug::LogInfo("Set I to the location of the sprite for digit V[", X,"]");
-							#endif
-							_reg->I = _reg->V[X] * 5 + 0x50;
-							break;
-						case (0x33):
-							#ifdef DEBUG
-								nDebug::LogInfo("Store BCD of V[", X,"] in memory locations I, I+1, I+2");
-							#endif
-							_mem[_reg->I] = _reg->V[X] / 100;
-							_mem[_reg->I + 1] = (_reg->V[X] / 10) % 10;
-							_mem[_reg->I + 2] = _reg->V[X] % 10;
-							break;
-						case (0x55):
-							#ifdef DEBUG
-								nDebug::LogInfo("Store registers V[0] to V[", X,"] in memory starting at I");
-							#endif
-							for (int i = 0; i <= X; ++i) {
-								_mem[_reg->I + i] = _reg->V[i];
-							}
-							break;
-						case (0x65):
-							#ifdef DEBUG
-								nDebug::LogInfo("Fill registers V[0] to V[", X,"] with values from memory starting at I");
-							#endif
-							for (int i = 0; i <= X; ++i) {
-								_reg->V[i] = _mem[_reg->I + i];
-							}
-							break;
-					}
-					break;
-				default:
-					#ifdef DEBUG
-						nDebug::LogInfo("Operation not implemented");
-						nDebug::LogValue("Instruction", instr);
-					#endif
-					break;
+		if (e.type == SDL_KEYDOWN) {
+			if (e.key.keysym.sym == SDLK_ESCAPE) {
+				quit = true;
 			}
-		}
-		
-		void HandleInputs() {
-			const uint8_t key_map[16] = {SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4,
-										  SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
-										  SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F,
-										  SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V};
-			for (int i = 0; i < 16; ++i) {
-				keypad[i] = (SDL_GetKeyboardState(NULL)[key_map[i]] != 0);
+			if (e.key.keysym.sym == SDLK_SPACE) {
+				cpu.SetState(!cpu.GetState());
+				if (cpu.GetState()) {
+					nDebug::LogInfo("Resuming CPU execution...");
+				} else {
+					nDebug::LogInfo("Pausing CPU execution...");
+				}
 			}
-		}
-		void HandleTimers() {
-			if (*_delay > 0) {
-				--(*_delay);
+			if (e.key.keysym.sym == SDLK_F1) {
+				dbg.Break();
 			}
-			if (*_sound > 0) {				
-				#ifdef DEBUG
-					nDebug::LogInfo("BEEP!");
-				#endif
-				--(*_sound);
+			if (e.key.keysym.sym == SDLK_F2) {
+				OpenPicker();
 			}
-		}
-
-		void Run () {
-			GetState();
-			if (!state) {
-				return;
+			if (e.key.keysym.sym == SDLK_F5) {
+				cpu.Reset();
+				ClearColors();
+				fault_reported = false;
+				nDebug::LogInfo("Reset");
 			}
-			#ifdef DEBUG
-				nDebug::LogInfo("Step: ", cycle);
-			#endif
-
-			Fetch();			
-			Decode();
-			Execute();
-			cycle++;
-
-			#ifdef DEBUG
-				nDebug::LogInfo("");
-			#endif
-		}
-
-		void PrintRegisters () {
-			nDebug::LogValue("Instr", instr);
-			nDebug::LogValue("NNN", NNN);
-			nDebug::LogValue("NN", NN);
-			nDebug::LogValue("N", N);
-			nDebug::LogValue("X", X);
-			nDebug::LogValue("Y", Y);
-			nDebug::LogInfo("");
-
-			_reg->PrintRegisters();
-		}
-
-		void MemDump () {
-			for (int i = 0; i < 4 * ONE_K; ++i) {
-				if ((i % 16) == 0) {
-					std::cout << std::setfill('0') << std::setw(4) << i <<": ";
-					for (int j = 0; j < 16; ++j) {
-						std::cout << std::setfill('0') << std::setw(2) << std::hex << static_cast<int> (_mem[i + j]) << " ";
-					}
-					std::cout << std::endl;
+			if (e.key.keysym.sym == SDLK_F6 || e.key.keysym.sym == SDLK_F7) {
+				SwitchRom(cpu, sdl_ctl, input, NeighbourRom(e.key.keysym.sym == SDLK_F7 ? 1 : -1));
+			}
+			if (e.key.keysym.sym == SDLK_F11) {
+				if (capture.Recording()) {
+					capture.StopVideo();
+					nDebug::LogInfo("Stopped recording");
+				} else {
+					char name[64];
+					snprintf(name, sizeof name, "capture_%ld.c8v", (long) time(nullptr));
+					capture.StartVideo(name);
+					nDebug::LogInfo("Recording to " + std::string(name));
 				}
 			}
+			if (e.key.keysym.sym == SDLK_F12) {
+				capture.Screenshot(color_buffer);
+			}
 		}
-
-		// void DispDump() {
-		// 	for (int y = 0; y < DISP_HEIGHT; ++y) {
-		// 		for (int x = 0; x < DISP_WIDTH; ++x) {
-		// 			if (_disp[y * DISP_WIDTH + x]) {
-		// 				std::cout << "*";
-		// 			} else {
-		// 				std::cout << " ";
-		// 			}
-		// 		}
-		// 		std::cout << std::endl;
-		// 	}
-		// }
-
-		void SetState (bool state) {
-			this->state = state;
-		}
-		bool GetState () {
-			return state;
-		}
-
-};
+	}
+	return quit;
+}
 
 int main(int argc, char **argv) {
-    if (!LoadROM(argc, argv, memory)) {
-		nDebug::LogInfo("Found an error while loading memory from ROM");
-
+	if (argc < 2) {
+		nDebug::LogInfo("Usage: <rom_name|rom_dir> [-c <config>] [-d] [-k <bindings>] [-i <input slices>] [-s <w>x<h>] [-f <filter>] [-r <video.c8v|video.y4m>] [-l <debug|info|warn|error>] [--timing=<flat|vip>] [--runahead=<frames>] [--coverage=<prefix>] [--net_peer=<host:port> --net_port=<port>] [--socket=<path>] [--shm=</name>] [--library=<dir;dir>] [--<key>=<value>]");
+		return -1;
+	}
+	if (!config_layers.SetFromArgs(argc, argv, 2)) {
 		return -1;
 	}
+	if (!config_layers.FileLoaded()) {
+		config_layers.LoadFile(CONFIG_FILE);
+	}
 
 	sRegister	reg;
 	sSDL		sdl;
 
 	cCPU cpu(reg, memory, delay_timer, sound_timer, frame_buffer);
 	cSDL sdl_ctl(sdl.dispWindow, sdl.dispRenderer);
+	cDebugger dbg(cpu, reg, memory, &cheats);
+	cInput input;
+	cCapture capture;
+	cRemote remote(cpu, reg);
+	cShmExport shm(cpu, reg, frame_buffer);
+	coverage = cCoverage(cpu, reg, memory);
+	cFusion fusion(cpu);
+
+	// A directory instead of a ROM starts in the picker with nothing loaded.
+	const bool browse = std::filesystem::is_directory(argv[1]);
+	if (browse) {
+		config = config_layers.Resolve(0);
+		ApplyConfig(sdl_ctl, input);
+		cpu.SetState(false);
+	} else if (!SwitchRom(cpu, sdl_ctl, input, argv[1])) {
+		nDebug::LogInfo("Found an error while loading memory from ROM");
 
-	cpu.InitToRom();
-	cpu.LoadFontToMem();
+		return -1;
+	}
+	std::stringstream dirs(config.library);
+	for (std::string dir; std::getline(dirs, dir, ';'); ) {
+		if (!dir.empty()) {
+			library_dirs.push_back(dir);
+		}
+	}
+	if (browse) {
+		library_dirs.push_back(argv[1]);
+	} else if (library_dirs.empty()) {
+		const std::filesystem::path dir = std::filesystem::path(rom_path).parent_path();
+		library_dirs.push_back(dir.empty() ? "." : dir.string());
+	}
+	library_cache = config.library_cache;
+	library.LoadCache(library_cache.c_str());
+	if (!config.video.empty()) {
+		capture.StartVideo(config.video.c_str());
+	}
+	if (!config.socket.empty()) {
+		if (!remote.Listen(config.socket.c_str())) {
+			nDebug::LogError("Unable to listen on " + config.socket);
+		}
+		remote.on_load = [&](const std::string &path) {
+			if (!SwitchRom(cpu, sdl_ctl, input, path)) {
+				return false;
+			}
+			if (picker.Active()) {
+				picker.Close();
+			}
+			return true;
+		};
+		remote.on_reset = [] {
+			ClearColors();
+			fault_reported = false;
+		};
+	}
+	if (!config.shm.empty() && !shm.Open(config.shm.c_str())) {
+		nDebug::LogError("Unable to create shared memory segment " + config.shm);
+	}
+	coverage.SetActive(!config.coverage.empty());
+	if (!config.net_peer.empty()) {
+		if (browse) {
+			nDebug::LogError("Netplay needs a ROM on the command line");
+		} else if (netplay.Open(cpu, rom_hash, config.net_port, config.net_peer, plan.budget, config.net_delay)) {
+			netplay.SetShim(config.net_latency, config.net_jitter, config.net_loss);
+			input.Detach(true);
+			remote.Lock(true);
+			nDebug::LogInfo("Netplay on port ", config.net_port, ", peer " + config.net_peer);
+		} else {
+			nDebug::LogError("Unable to start netplay with " + config.net_peer);
+		}
+	}
+
+	// The debugger steps the core outside the rollback timeline, and a
+	// directory leaves no core to step until a ROM is picked.
+	if (config.debug && !netplay.Active() && !browse) {
+		dbg.Break();
+	}
 
-	sdl_ctl.InitSDL();
-	memset(color_buffer, BG_COLOR, sizeof color_buffer);
+	sdl_ctl.InitSDL(config.win_width, config.win_height);
+	if (browse) {
+		OpenPicker();
+	}
 	bool quit = false;
 
-    SDL_Event e;
 	while (!quit) {
-		while (SDL_PollEvent(&e) != 0) {
-	        if (e.type == SDL_QUIT) {
-	            quit = true;
-	        }
-			if (e.type == SDL_KEYDOWN) {
-				if (e.key.keysym.sym == SDLK_ESCAPE) {
-					quit = true;
+		const uint64_t start_frame = SDL_GetPerformanceCounter();
+		// Netplay runs whole frames itself, input latch included.
+		if (netplay.Active()) {
+			quit = HandleEvents(cpu, sdl_ctl, dbg, input, capture);
+			remote.Poll();
+			netplay.Frame(cpu, input.Sample());
+			cpu.Touch();
+		}
+		PollLibrary();
+		remote.SetEmpty(rom_path.empty());
+		// The picker holds the CPU while it is open.
+		if (picker.Active()) {
+			quit = HandleEvents(cpu, sdl_ctl, dbg, input, capture);
+			remote.Poll();
+		}
+		// Slices end at fixed offsets into the frame's cycle range, so an
+		// instruction running past one (or a VIP draw waiting out the frame)
+		// shortens what follows instead of pushing the frame along.
+		long int frame_start = cpu.GetCycle() - cpu.GetCycle() % plan.budget;
+		long int slice_end = frame_start;
+		for (size_t s = 0; s < plan.slice_budget.size() && !quit && !netplay.Active() && !picker.Active(); ++s) {
+			quit = HandleEvents(cpu, sdl_ctl, dbg, input, capture);
+			remote.Poll();
+			// A reset or ROM switch in there restarts the cycle count; the
+			// rest of the frame goes back on the new machine's grid rather
+			// than running it up to the old one's offsets.
+			if (cpu.GetCycle() < frame_start) {
+				frame_start = slice_end = cpu.GetCycle() - cpu.GetCycle() % plan.budget;
+			}
+			slice_end += plan.slice_budget[s];
+			if (dbg.Active()) {
+				while (cpu.GetCycle() < slice_end && cpu.GetState() && !quit) {
+					quit = !dbg.Step();
 				}
-				if (e.key.keysym.sym == SDLK_SPACE) {
-					cpu.SetState(!cpu.GetState());
-					if (cpu.GetState()) {
-						nDebug::LogInfo("Resuming CPU execution...");
-					} else {
-						nDebug::LogInfo("Pausing CPU execution...");
-					}
+				cpu.Touch();
+			} else if (cheats.Active() || coverage.Active()) {
+				while (cpu.GetCycle() < slice_end && cpu.GetState()) {
+					coverage.Record();
+					cpu.Run();
+					cheats.Apply();
 				}
+				cpu.Touch();
+			} else if (plan.fused) {
+				fusion.RunUntil(slice_end);
+			} else {
+				cpu.RunUntil(slice_end);
 			}
-
-	    }
-		const uint64_t start_frame = SDL_GetPerformanceCounter();
-		for (int i = 0; i < INST_PER_SEC / 60; ++i) {
-			cpu.Run();
 		}
+		if (cpu.GetFault() && !fault_reported) {
+			nDebug::LogError(cpu.GetFault() == FAULT_STACK_OVERFLOW ? "CPU halted: stack overflow" : "CPU halted: stack underflow");
+			fault_reported = true;
+		}
+		if (!netplay.Active()) {
+			cpu.LatchInputs();
+		}
+		shm.Publish();
+		if (picker.Active()) {
+			sdl_ctl.UpdateOverlay(picker.Render(config.fg_color, config.bg_color), PICKER_WIDTH, PICKER_HEIGHT);
+		} else {
+			sdl_ctl.UpdateFrame((dbg.Active() || netplay.Active()) ? frame_buffer : runahead.Frame(cpu, frame_buffer, &cheats), color_buffer);
+		}
+		input.FramePresented();
+		capture.Frame(frame_buffer);
+		remote.Frame(frame_buffer);
+
 		const uint64_t end_frame = SDL_GetPerformanceCounter();
 		const double elapsed = (double) ((end_frame - start_frame) * 1000) / SDL_GetPerformanceFrequency();
-		if (elapsed < DELAY_MS) {
-			SDL_Delay(DELAY_MS - elapsed);
+		if (elapsed < plan.frame_ms) {
+			SDL_Delay(plan.frame_ms - elapsed);
 		}
-		sdl_ctl.UpdateFrame(frame_buffer, color_buffer);
-		cpu.HandleTimers();
-		cpu.HandleInputs();
 	}
 
 	sdl_ctl.QuitSDL();
+	input.PrintStats();
+	runahead.PrintStats(plan.frame_ms);
+	netplay.PrintStats();
+	if (coverage.Active()) {
+		const std::string png = config.coverage + ".png", txt = config.coverage + ".txt";
+		if (coverage.WriteHeatMap(png.c_str()) && coverage.WriteReport(txt.c_str())) {
+			nDebug::LogInfo("Coverage written to " + png + " and " + txt);
+		} else {
+			nDebug::LogError("Unable to write coverage to " + config.coverage);
+		}
+	}
 
 	#ifdef DEBUG
 		nDebug::LogInfo("Dumping Memory...");
+		nDebug::Flush();
 		cpu.MemDump();
 	#endif
 
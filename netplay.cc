@@ -0,0 +1,109 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_CPU.h"
+#include "std_Rom.h"
+#include "std_Netplay.h"
+
+// Headless netplay peer for testing rollback without a window. Plays random
+// key presses at 60 Hz against another instance, then waits until every
+// frame is confirmed and reports rollbacks and state checksums:
+//
+//   netplay <rom> <port> <peer host:port> [-n frames] [-d delay]
+//           [-l latency ms] [-j jitter ms] [-x loss] [-k key seed]
+//
+// e.g. two shells on one machine:
+//   ./netplay Tetris.ch8 7000 127.0.0.1:7001 -l 40 -j 30 -x 0.05 -k 1
+//   ./netplay Tetris.ch8 7001 127.0.0.1:7000 -l 40 -j 30 -x 0.05 -k 2
+
+struct sMachine {
+	sRegister	reg;
+	uint8_t		memory[MEM_SIZE] {};
+	uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+	uint8_t		delay_timer{};
+	uint8_t		sound_timer{};
+};
+
+sMachine machine;
+cNetplay net;
+
+int main (int argc, char **argv) {
+	if (argc < 4) {
+		nDebug::LogInfo("Usage: netplay <rom> <port> <peer host:port> [-n frames] [-d delay] [-l latency] [-j jitter] [-x loss] [-k seed]");
+		return -1;
+	}
+	uint32_t frames = 600;
+	int delay = 2;
+	double latency = 0, jitter = 0, loss = 0;
+	uint32_t keys = 1;
+	for (int i = 4; i + 1 < argc; i += 2) {
+		const std::string flag = argv[i];
+		if (flag == "-n") {
+			frames = std::atoi(argv[i + 1]);
+		} else if (flag == "-d") {
+			delay = std::atoi(argv[i + 1]);
+		} else if (flag == "-l") {
+			latency = std::atof(argv[i + 1]);
+		} else if (flag == "-j") {
+			jitter = std::atof(argv[i + 1]);
+		} else if (flag == "-x") {
+			loss = std::atof(argv[i + 1]);
+		} else if (flag == "-k") {
+			keys = std::strtoul(argv[i + 1], nullptr, 10) | 1;
+		} else {
+			nDebug::LogError("Unknown option " + flag);
+			return -1;
+		}
+	}
+
+	std::vector<uint8_t> image;
+	if (!nRom::Read(argv[1], image)) {
+		nDebug::LogError(std::string("Unable to open ") + argv[1]);
+		return -1;
+	}
+	cCPU cpu(machine.reg, machine.memory, machine.delay_timer, machine.sound_timer, machine.frame_buffer);
+	cpu.Boot(image.data(), image.size());
+	if (!net.Open(cpu, nHash::Fnv1a(image.data(), image.size()), std::atoi(argv[2]), argv[3], INST_PER_SEC / 60, delay)) {
+		nDebug::LogError(std::string("Unable to start netplay with ") + argv[3]);
+		return -1;
+	}
+	net.SetShim(latency, jitter, loss);
+
+	// A key goes down for a few frames now and then, like a player would.
+	uint16_t held = 0;
+	int hold_frames = 0;
+	auto next = std::chrono::steady_clock::now();
+	const auto frame_time = std::chrono::microseconds(16667);
+	const auto give_up = next + std::chrono::seconds(frames / 60 + 30);
+	while (net.Confirmed() < frames && next < give_up) {
+		if (net.FrameNo() < frames) {
+			if (hold_frames-- <= 0) {
+				keys ^= keys << 13;
+				keys ^= keys >> 17;
+				keys ^= keys << 5;
+				held = (keys & 3) ? 0 : 1 << ((keys >> 8) & 15);
+				hold_frames = 1 + (keys >> 16) % 8;
+			}
+			net.Frame(cpu, held);
+		} else {
+			net.Poll(cpu);
+		}
+		next += frame_time;
+		std::this_thread::sleep_until(next);
+	}
+	// Keep answering so the peer hears about our last frames too.
+	for (int i = 0; i < 60; ++i) {
+		net.Poll(cpu);
+		std::this_thread::sleep_for(frame_time);
+	}
+
+	net.PrintStats();
+	nDebug::Flush();
+	if (net.Confirmed() < frames) {
+		nDebug::LogError("Peer stopped answering");
+		return 1;
+	}
+	return net.Desyncs() ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+#include <cstdarg>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_FlowGraph.h"
+#include "std_Rom.h"
+
+// Ahead-of-time recompiler: finds the ROM's code with cFlowAnalyzer from
+// ROM_ENTRYPOINT and writes a C++ translation unit with one function per
+// basic block for the runtime in std_Aot.h. Blocks that overlap statically
+// known stores are left to the interpreter.
+//
+//   recomp <rom> [out.cc]
+//
+// Build the output with -DAOT_BENCH for a driver that checks it against the
+// interpreter and reports the speedup (make recomp does this for every ROM).
+
+#define AOT_MAX_COUNT	255
+
+uint8_t memory[MEM_SIZE] {};
+
+std::string Format (const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+std::string Format (const char* fmt, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof buf, fmt, args);
+	va_end(args);
+	return buf;
+}
+
+// Straight-line opcodes, written as cCPU::Execute has them. at is the
+// instruction's index in its block, which the timer helpers need.
+std::string Body (const sOpcode &op, int at) {
+	const int X = op.X, Y = op.Y;
+	switch (op.instr >> 12) {
+		case (0x0):
+			return (op.NNN == 0x00E0) ? "a.ClearScreen();" : "";
+		case (0x6):
+			return Format("a.r.V[0x%X] = 0x%02X;", X, op.NN);
+		case (0x7):
+			return Format("a.r.V[0x%X] += 0x%02X;", X, op.NN);
+		case (0x8):
+			switch (op.N) {
+				case (0x0): return Format("a.r.V[0x%X] = a.r.V[0x%X];", X, Y);
+				case (0x1): return Format("a.r.V[0x%X] |= a.r.V[0x%X];", X, Y);
+				case (0x2): return Format("a.r.V[0x%X] &= a.r.V[0x%X];", X, Y);
+				case (0x3): return Format("a.r.V[0x%X] ^= a.r.V[0x%X];", X, Y);
+				case (0x4): return Format("a.r.V[0x%X] += a.r.V[0x%X]; if (a.r.V[0x%X] < a.r.V[0x%X]) { a.r.V[0xF] = 0x1; }", X, Y, X, Y);
+				case (0x5): return Format("a.r.V[0x%X] -= a.r.V[0x%X]; a.r.V[0xF] = (a.r.V[0x%X] < a.r.V[0x%X]) ? 0x1 : 0x0;", X, Y, X, Y);
+				case (0x6): return Format("a.r.V[0xF] = a.r.V[0x%X] & 0x01; a.r.V[0x%X] >>= 1;", X, X);
+				case (0x7): return Format("a.r.V[0x%X] = a.r.V[0x%X] - a.r.V[0x%X]; a.r.V[0xF] = (a.r.V[0x%X] > a.r.V[0x%X]) ? 0x1 : 0x0;", X, Y, X, Y, X);
+				case (0xE): return Format("a.r.V[0xF] = (a.r.V[0x%X] & 0x80) >> 7; a.r.V[0x%X] <<= 1;", X, X);
+			}
+			return "";
+		case (0xA):
+			return Format("a.r.I = 0x%03X;", op.NNN);
+		case (0xC):
+			return Format("a.r.V[0x%X] = a.Random(0x%02X);", X, op.NN);
+		case (0xD):
+			return Format("a.Draw(0x%X, 0x%X, %d);", X, Y, op.N);
+		case (0xF):
+			switch (op.NN) {
+				case (0x1E): return Format("a.r.I += a.r.V[0x%X]; if (a.r.I > 0x1000) { a.r.V[0xF] = 0x1; }", X);
+				case (0x07): return Format("a.r.V[0x%X] = a.Delay(%d);", X, at);
+				case (0x15): return Format("a.SetDelay(%d, a.r.V[0x%X]);", at, X);
+				case (0x18): return Format("a.SetSound(%d, a.r.V[0x%X]);", at, X);
+				case (0x29): return Format("a.r.I = a.r.V[0x%X] * 5 + 0x50;", X);
+				case (0x65): return Format("a.Load(0x%X);", X);
+			}
+			return "";
+	}
+	return "";
+}
+
+// The skip condition of 3xnn/4xnn/5xy_/9xy_/Ex9E/ExA1, or "" for anything else.
+// 5xyN and 9xyN skip for every N in the core, so they do here too.
+std::string SkipCondition (const sOpcode &op) {
+	switch (op.instr >> 12) {
+		case (0x3): return Format("a.r.V[0x%X] == 0x%02X", op.X, op.NN);
+		case (0x4): return Format("a.r.V[0x%X] != 0x%02X", op.X, op.NN);
+		case (0x5): return Format("a.r.V[0x%X] == a.r.V[0x%X]", op.X, op.Y);
+		case (0x9): return Format("a.r.V[0x%X] != a.r.V[0x%X]", op.X, op.Y);
+		case (0xE):
+			if (op.NN == 0x9E) {
+				return Format("a.Key(a.r.V[0x%X])", op.X);
+			}
+			if (op.NN == 0xA1) {
+				return Format("!a.Key(a.r.V[0x%X])", op.X);
+			}
+	}
+	return "";
+}
+
+void EmitBlock (std::ostream &out, const sBlock &blk) {
+	out << Format("static int B%03X (cAot &a) {\n", blk.start);
+	int k = 0;
+	for (uint16_t pc = blk.start; pc < blk.end; pc += 2) {
+		const sOpcode op((memory[pc] << 8) | memory[pc + 1]);
+		const bool last = pc + 2 >= blk.end;
+		k++;
+		out << Format("\t// %03X: %04X\n", pc, op.instr);
+		const std::string skip = SkipCondition(op);
+		if (op.instr == 0x00EE) {
+			out << Format("\ta.Return();\n\treturn %d;\n", k);
+		} else if ((op.instr >> 12) == 0x1) {
+			out << Format("\ta.r.PC = 0x%03X;\n\treturn %d;\n", op.NNN, k);
+		} else if ((op.instr >> 12) == 0x2) {
+			out << Format("\ta.Call(0x%03X, 0x%03X);\n\treturn %d;\n", pc + 2, op.NNN, k);
+		} else if ((op.instr >> 12) == 0xB) {
+			out << Format("\ta.r.PC = 0x%03X + a.r.V[0];\n\treturn %d;\n", op.NNN, k);
+		} else if (!skip.empty() && last) {
+			out << Format("\ta.r.PC = (%s) ? 0x%03X : 0x%03X;\n\treturn %d;\n", skip.c_str(), pc + 4, pc + 2, k);
+		} else if (!skip.empty()) {
+			out << Format("\tif (%s) {\n\t\ta.r.PC = 0x%03X;\n\t\treturn %d;\n\t}\n", skip.c_str(), pc + 4, k);
+		} else if ((op.instr & 0xF0FF) == 0xF033 || (op.instr & 0xF0FF) == 0xF055) {
+			out << Format("\tif (a.%s(0x%X)) {\n\t\ta.r.PC = 0x%03X;\n\t\treturn %d;\n\t}\n",
+						  op.NN == 0x33 ? "Bcd" : "Store", op.X, pc + 2, k);
+		} else if ((op.instr & 0xF0FF) == 0xF00A) {
+			out << Format("\tif (!a.WaitKey(0x%X)) {\n\t\ta.r.PC = 0x%03X;\n\t\treturn %d;\n\t}\n", op.X, pc, k);
+		} else {
+			const std::string body = Body(op, k - 1);
+			if (!body.empty()) {
+				out << "\t" << body << "\n";
+			}
+		}
+		if (last && (op.instr == 0x00EE || (op.instr >> 12) == 0x1 || (op.instr >> 12) == 0x2 || (op.instr >> 12) == 0xB
+					 || !skip.empty())) {
+			break;
+		}
+		if (last) {
+			out << Format("\ta.r.PC = 0x%03X;\n\treturn %d;\n", blk.end, k);
+		}
+	}
+	out << "}\n\n";
+}
+
+int main (int argc, char **argv) {
+	if (argc < 2) {
+		nDebug::LogInfo("Usage: recomp <rom> [out.cc]");
+		return -1;
+	}
+	std::vector<uint8_t> image;
+	if (!nRom::Read(argv[1], image)) {
+		nDebug::LogError(std::string("Unable to open ") + argv[1]);
+		return -1;
+	}
+	std::memcpy(&memory[ROM_ENTRYPOINT], image.data(), image.size());
+
+	cFlowAnalyzer flow;
+	flow.Analyze(memory, ROM_ENTRYPOINT, ROM_ENTRYPOINT + image.size());
+
+	std::ofstream file;
+	if (argc > 2) {
+		file.open(argv[2]);
+		if (!file) {
+			nDebug::LogError(std::string("Unable to write ") + argv[2]);
+			return -1;
+		}
+	}
+	std::ostream &out = (argc > 2) ? file : std::cout;
+
+	std::string name = std::filesystem::path(argv[1]).filename().string();
+	std::string escaped;
+	for (const char c : name) {
+		escaped += (c == '"' || c == '\\') ? std::string("\\") + c : std::string(1, c);
+	}
+
+	out << "// Generated by recomp from " << name << ". Do not edit.\n";
+	out << "#include \"std_Aot.h\"\n\n";
+	out << "static const uint8_t image[] = {";
+	for (size_t i = 0; i < image.size(); ++i) {
+		out << ((i % 16) ? " " : "\n\t") << Format("0x%02X,", image[i]);
+	}
+	out << "\n};\n\n";
+
+	std::vector<const sBlock*> compiled;
+	int skipped = 0;
+	for (const sBlock &blk : flow.blocks) {
+		bool modified = (blk.end - blk.start) / 2 > AOT_MAX_COUNT;
+		for (uint16_t addr = blk.start; addr < blk.end; ++addr) {
+			modified |= flow.IsSelfModified(addr);
+		}
+		if (modified) {
+			skipped++;
+			continue;
+		}
+		EmitBlock(out, blk);
+		compiled.push_back(&blk);
+	}
+
+	out << "static const sAotBlock blocks[] = {\n";
+	for (const sBlock* blk : compiled) {
+		out << Format("\t{0x%03X, 0x%03X, %d, B%03X},\n", blk->start, blk->end, (blk->end - blk->start) / 2, blk->start);
+	}
+	if (compiled.empty()) {
+		out << "\t{0, 0, 0, nullptr},\n";
+	}
+	out << "};\n\n";
+	out << "extern const sAotProgram AOT_PROGRAM = {\"" << escaped << "\", image, sizeof image, blocks, "
+		<< compiled.size() << "};\n\n";
+	out << "#ifdef AOT_BENCH\nint main (int argc, char **argv) {\n\treturn nAot::Bench(AOT_PROGRAM, argc, argv);\n}\n#endif\n";
+
+	fprintf(stderr, "%s: %zu blocks translated, %d left to the interpreter, %d code bytes, %d unresolved stores\n",
+			name.c_str(), compiled.size(), skipped, flow.CodeBytes(), flow.unknown_stores);
+	return 0;
+}
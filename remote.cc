@@ -0,0 +1,164 @@
+#include <chrono>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_Remote.h"
+
+// Stand-in client for the remote control socket (main --socket=<path>).
+// Commands run in order, each waiting for its reply:
+//
+//   remote <socket> load <rom> | key <hex> <0|1> | step <n> | pause <0|1>
+//                   | reset | regs | watch <frames>
+//
+// watch subscribes to frames and registers, rebuilds the screen from the
+// row diffs and prints it with the bandwidth it took.
+
+int sock = -1;
+
+bool Request (uint8_t op, const void* payload, size_t len) {
+	uint8_t msg[REMOTE_MAX_MESSAGE];
+	const sRemoteHeader h {op, 0, (uint16_t) len};
+	std::memcpy(msg, &h, sizeof h);
+	std::memcpy(msg + sizeof h, payload, len);
+	return send(sock, msg, sizeof h + len, MSG_NOSIGNAL) == (ssize_t) (sizeof h + len);
+}
+
+// Next message from the emulator; len is the payload size.
+bool Receive (sRemoteHeader &h, uint8_t* payload, size_t &len) {
+	uint8_t msg[REMOTE_MAX_MESSAGE];
+	const ssize_t n = recv(sock, msg, sizeof msg, 0);
+	if (n < (ssize_t) sizeof h) {
+		return false;
+	}
+	std::memcpy(&h, msg, sizeof h);
+	len = n - sizeof h;
+	std::memcpy(payload, msg + sizeof h, len);
+	return true;
+}
+
+bool WaitAck (uint8_t op) {
+	sRemoteHeader h;
+	uint8_t payload[REMOTE_MAX_MESSAGE];
+	size_t len;
+	while (Receive(h, payload, len)) {
+		if (h.type == MSG_ACK && len == 2 && payload[0] == op) {
+			return payload[1];
+		}
+	}
+	return false;
+}
+
+void PrintRegs (const sRemoteRegs &r) {
+	printf("PC=%03X I=%03X SP=%d DT=%02X ST=%02X cycle=%llu %s%s\n", r.PC, r.I, r.sp, r.delay_timer, r.sound_timer,
+		   (unsigned long long) r.cycle, r.running ? "running" : "paused", r.fault ? " (faulted)" : "");
+	for (int i = 0; i < 16; ++i) {
+		printf("V%X=%02X%s", i, r.V[i], (i % 8 == 7) ? "\n" : " ");
+	}
+}
+
+bool Watch (int frames) {
+	const uint8_t mask = REMOTE_FRAMES | REMOTE_REGS;
+	if (!Request(OP_SUBSCRIBE, &mask, 1) || !WaitAck(OP_SUBSCRIBE)) {
+		return false;
+	}
+	uint64_t rows[DISP_HEIGHT] {};
+	sRemoteRegs regs {};
+	size_t bytes = 0;
+	int frame_msgs = 0, changed_rows = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int seen = 0; seen < frames; ) {
+		sRemoteHeader h;
+		uint8_t payload[REMOTE_MAX_MESSAGE];
+		size_t len;
+		if (!Receive(h, payload, len)) {
+			return false;
+		}
+		bytes += sizeof h + len;
+		if (h.type == MSG_FRAME && len >= 5 && len == 5 + payload[4] * 9u) {
+			for (int i = 0; i < payload[4]; ++i) {
+				uint64_t x;
+				std::memcpy(&x, &payload[5 + i * 9 + 1], 8);
+				rows[payload[5 + i * 9] % DISP_HEIGHT] ^= x;
+			}
+			frame_msgs++;
+			changed_rows += payload[4];
+		} else if (h.type == MSG_REGS && len == sizeof regs) {
+			std::memcpy(&regs, payload, sizeof regs);
+			seen++;
+		}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (int y = 0; y < DISP_HEIGHT; ++y) {
+		for (int x = 0; x < DISP_WIDTH; ++x) {
+			putchar((rows[y] >> (63 - x)) & 1 ? '#' : '.');
+		}
+		putchar('\n');
+	}
+	PrintRegs(regs);
+	printf("%d frames in %.2f s: %d frame messages, %d rows changed, %zu bytes\n",
+		   frames, seconds, frame_msgs, changed_rows, bytes);
+
+	const uint8_t off = 0;
+	return Request(OP_SUBSCRIBE, &off, 1) && WaitAck(OP_SUBSCRIBE);
+}
+
+int main (int argc, char **argv) {
+	if (argc < 3) {
+		nDebug::LogInfo("Usage: remote <socket> <command> [args]...");
+		return -1;
+	}
+	sockaddr_un addr {};
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof addr.sun_path, "%s", argv[1]);
+	sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (sock < 0 || connect(sock, (sockaddr*) &addr, sizeof addr) < 0) {
+		nDebug::LogError(std::string("Unable to connect to ") + argv[1]);
+		return -1;
+	}
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string cmd = argv[i];
+		const bool has_arg = i + 1 < argc;
+		bool ok = false;
+		if (cmd == "load" && has_arg) {
+			const char* path = argv[++i];
+			ok = Request(OP_LOAD, path, std::strlen(path)) && WaitAck(OP_LOAD);
+		} else if (cmd == "key" && i + 2 < argc) {
+			const uint8_t payload[2] = {(uint8_t) std::strtoul(argv[i + 1], nullptr, 16), (uint8_t) std::atoi(argv[i + 2])};
+			i += 2;
+			ok = Request(OP_KEY, payload, 2) && WaitAck(OP_KEY);
+		} else if (cmd == "step" && has_arg) {
+			const uint32_t count = std::strtoul(argv[++i], nullptr, 10);
+			ok = Request(OP_STEP, &count, 4) && WaitAck(OP_STEP);
+		} else if (cmd == "pause" && has_arg) {
+			const uint8_t paused = std::atoi(argv[++i]);
+			ok = Request(OP_PAUSE, &paused, 1) && WaitAck(OP_PAUSE);
+		} else if (cmd == "reset") {
+			ok = Request(OP_RESET, nullptr, 0) && WaitAck(OP_RESET);
+		} else if (cmd == "regs") {
+			sRemoteHeader h;
+			uint8_t payload[REMOTE_MAX_MESSAGE];
+			size_t len;
+			ok = Request(OP_REGS, nullptr, 0);
+			while (ok && (ok = Receive(h, payload, len)) && h.type != MSG_REGS) {}
+			if (ok && len == sizeof(sRemoteRegs)) {
+				sRemoteRegs r;
+				std::memcpy(&r, payload, sizeof r);
+				PrintRegs(r);
+			}
+		} else if (cmd == "watch" && has_arg) {
+			ok = Watch(std::atoi(argv[++i]));
+		} else {
+			nDebug::LogError("Unknown command " + cmd);
+			close(sock);
+			return -1;
+		}
+		if (!ok) {
+			nDebug::LogError("'" + cmd + "' failed");
+			close(sock);
+			return 1;
+		}
+	}
+	close(sock);
+	return 0;
+}
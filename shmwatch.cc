@@ -0,0 +1,59 @@
+#include <chrono>
+#include <thread>
+#include "std_CommonIncludes.h"
+#include "std_Chip8Includes.h"
+#include "std_Shm.h"
+
+// Reference consumer for the shared-memory export (main --shm=<name>).
+// Samples the segment for a while, then prints the last consistent frame and
+// how often a read raced the writer.
+//
+//   shmwatch <name> [seconds]
+
+int main (int argc, char **argv) {
+	if (argc < 2) {
+		nDebug::LogInfo("Usage: shmwatch <name> [seconds]");
+		return -1;
+	}
+	const sShmFrame* f = nShm::Attach(argv[1]);
+	if (!f) {
+		nDebug::LogError(std::string("No emulator publishing at ") + argv[1]);
+		return -1;
+	}
+	const double seconds = (argc > 2) ? std::atof(argv[2]) : 2.0;
+
+	uint8_t screen[DISP_WIDTH * DISP_HEIGHT];
+	uint32_t frame = 0, first = 0, retries = 0, samples = 0;
+	uint64_t cycle = 0;
+	uint16_t pc = 0, keypad = 0;
+	const auto start = std::chrono::steady_clock::now();
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds) {
+		uint32_t seq;
+		do {
+			seq = nShm::ReadBegin(*f);
+			frame = f->frame;
+			cycle = f->cycle;
+			pc = f->PC;
+			keypad = f->keypad;
+			std::memcpy(screen, f->frame_buffer, sizeof screen);
+			retries++;
+		} while (nShm::ReadRetry(*f, seq));
+		retries--;
+		if (samples++ == 0) {
+			first = frame;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	for (int y = 0; y < DISP_HEIGHT; ++y) {
+		for (int x = 0; x < DISP_WIDTH; ++x) {
+			putchar(screen[y * DISP_WIDTH + x] ? '#' : '.');
+		}
+		putchar('\n');
+	}
+	printf("frame %u (%u published while watching), cycle %llu, PC=%03X, keypad %04X\n",
+		   frame, frame - first, (unsigned long long) cycle, pc, keypad);
+	printf("%u samples, %u torn reads retried\n", samples, retries);
+	munmap((void*) f, sizeof *f);
+	return 0;
+}
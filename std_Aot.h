@@ -0,0 +1,292 @@
+#pragma once
+
+#ifndef AotCommon
+#define AotCommon
+
+#include <chrono>
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+class cAot;
+
+// A basic block translated by recomp: runs the block's instructions, leaves
+// PC where the interpreter would have, and returns how many it executed.
+typedef int (*tAotBlock) (cAot &a);
+
+struct sAotBlock {
+	uint16_t	start;
+	uint16_t	end;		// one past the last instruction byte
+	uint8_t		count;		// instructions in the block
+	tAotBlock	fn;
+};
+
+// What recomp emits for one ROM.
+struct sAotProgram {
+	const char*			name;
+	const uint8_t*		image;
+	size_t				size;
+	const sAotBlock*	blocks;
+	int					block_count;
+};
+
+// Runtime for recompiled ROMs. Drives the same cCPU state the interpreter
+// uses, entering a translated block whenever PC lands on one and handing a
+// single instruction to cCPU::Run otherwise (code only reached through a
+// return to a rewritten stack, code outside the analyzed image, the tail of
+// a frame shorter than the next block). A store into translated code drops
+// the blocks it touches for good, so self-modifying ROMs stay correct.
+//
+// Block bodies mirror cCPU::Execute opcode for opcode, quirks included, with
+// no eQuirk flags set.
+class cAot {
+	private:
+		cCPU*				_cpu{};
+		const sAotProgram*	_prog{};
+
+		tAotBlock	table[MEM_SIZE] {};
+		uint8_t		counts[MEM_SIZE] {};
+		bool		code[MEM_SIZE] {};
+
+		long int	native{};
+		long int	fallback{};
+		int			invalidated{};
+
+		// True when addr was translated code; its blocks will not run again.
+		bool Invalidate (uint16_t addr) {
+			addr &= MEM_MASK;
+			if (!code[addr]) {
+				return false;
+			}
+			for (int b = 0; b < _prog->block_count; ++b) {
+				const sAotBlock &blk = _prog->blocks[b];
+				if (addr >= blk.start && addr < blk.end && table[blk.start]) {
+					table[blk.start] = nullptr;
+					invalidated++;
+				}
+			}
+			code[addr] = false;
+			return true;
+		}
+
+	public:
+		sRegister&	r;
+		uint8_t*	mem;
+		uint8_t*	disp;
+
+		cAot (cCPU &cpu, const sAotProgram &prog) : _cpu(&cpu), _prog(&prog), r(*cpu._reg), mem(cpu._mem), disp(cpu._disp) {
+			for (int b = 0; b < prog.block_count; ++b) {
+				const sAotBlock &blk = prog.blocks[b];
+				table[blk.start] = blk.fn;
+				counts[blk.start] = blk.count;
+				for (uint16_t addr = blk.start; addr < blk.end; ++addr) {
+					code[addr & MEM_MASK] = true;
+				}
+			}
+		}
+
+		// cCPU::RunFrame, instruction for instruction.
+		void RunFrame (int budget = INST_PER_SEC / 60) {
+			int left = budget;
+			while (left > 0 && _cpu->state) {
+				const uint16_t pc = r.PC & MEM_MASK;
+				if (table[pc] && counts[pc] <= left) {
+					const int n = table[pc](*this);
+					left -= n;
+					_cpu->cycle += n;
+					native += n;
+					continue;
+				}
+				const sOpcode op((mem[pc] << 8) | mem[(pc + 1) & MEM_MASK]);
+				if ((op.instr >> 12) == 0xF && (op.NN == 0x33 || op.NN == 0x55)) {
+					const int len = (op.NN == 0x33) ? 3 : op.X + 1;
+					for (int i = 0; i < len; ++i) {
+						Invalidate(r.I + i);
+					}
+				}
+				_cpu->Run();
+				left--;
+				fallback++;
+			}
+			_cpu->LatchInputs();
+		}
+
+		long int Native () const {
+			return native;
+		}
+		long int Fallback () const {
+			return fallback;
+		}
+		int Invalidated () const {
+			return invalidated;
+		}
+
+		// Helpers the generated blocks call for the opcodes that touch more
+		// than registers.
+		void ClearScreen () {
+			disp[0] = 0;
+		}
+		void Call (uint16_t ret, uint16_t target) {
+			_cpu->stack[_cpu->sp & (STACK_SLOTS - 1)] = ret;
+			_cpu->sp++;
+			_cpu->fault |= (_cpu->sp > STACK_DEPTH) * FAULT_STACK_OVERFLOW;
+			_cpu->state &= !_cpu->fault;
+			r.PC = target;
+		}
+		void Return () {
+			_cpu->fault |= (_cpu->sp == 0) * FAULT_STACK_UNDERFLOW;
+			_cpu->sp -= (_cpu->sp != 0);
+			r.PC = _cpu->stack[_cpu->sp & (STACK_SLOTS - 1)];
+			_cpu->state &= !_cpu->fault;
+		}
+		uint8_t Random (uint8_t mask) {
+			uint8_t value = _cpu->Random() % 0xFF;
+			return value & mask;
+		}
+		void Draw (uint8_t x, uint8_t y, uint8_t n) {
+			uint8_t X_coord = r.V[x] % DISP_WIDTH;
+			uint8_t Y_coord = r.V[y] % DISP_HEIGHT;
+			const uint8_t orig_X = X_coord;
+			r.V[0xF] = 0;
+			for (uint8_t i = 0; i < n; i++) {
+				const uint8_t sprite_data = mem[(r.I + i) & MEM_MASK];
+				X_coord = orig_X;
+				for (int8_t j = 7; j >= 0; j--) {
+					uint8_t *pixel = &disp[Y_coord * DISP_WIDTH + X_coord];
+					const bool sprite_bit = (sprite_data & (1 << j));
+					if (sprite_bit && *pixel) {
+						r.V[0xF] = 1;
+					}
+					*pixel ^= sprite_bit;
+					if (++X_coord >= DISP_WIDTH)   break;
+				}
+				if (++Y_coord >= DISP_HEIGHT)  break;
+			}
+		}
+		bool Key (uint8_t key) const {
+			return _cpu->keypad[key & 0x0F];
+		}
+		// Fx0A; false leaves the block so the wait is retried like in the core.
+		bool WaitKey (uint8_t x) {
+			for (int i = 0; i < 16; ++i) {
+				if (_cpu->keypad[i]) {
+					r.V[x] = i;
+					return true;
+				}
+			}
+			return false;
+		}
+		// Timer access from the at-th instruction of a block (0 for the
+		// first): cycle only moves once the block returns.
+		uint8_t Delay (int at) {
+			_cpu->cycle += at;
+			const uint8_t value = _cpu->DelayTimer();
+			_cpu->cycle -= at;
+			return value;
+		}
+		void SetDelay (int at, uint8_t value) {
+			_cpu->cycle += at;
+			_cpu->SetDelayTimer(value);
+			_cpu->cycle -= at;
+		}
+		void SetSound (int at, uint8_t value) {
+			_cpu->cycle += at;
+			_cpu->SetSoundTimer(value);
+			_cpu->cycle -= at;
+		}
+		// Fx33 / Fx55. True when the store hit translated code, in which case
+		// the calling block must stop: its remaining instructions may be stale.
+		bool Bcd (uint8_t x) {
+			bool hit = false;
+			for (int i = 0; i < 3; ++i) {
+				hit |= Invalidate(r.I + i);
+			}
+			mem[r.I & MEM_MASK] = r.V[x] / 100;
+			mem[(r.I + 1) & MEM_MASK] = (r.V[x] / 10) % 10;
+			mem[(r.I + 2) & MEM_MASK] = r.V[x] % 10;
+			return hit;
+		}
+		bool Store (uint8_t x) {
+			bool hit = false;
+			for (int i = 0; i <= x; ++i) {
+				hit |= Invalidate(r.I + i);
+				mem[(r.I + i) & MEM_MASK] = r.V[i];
+			}
+			return hit;
+		}
+		void Load (uint8_t x) {
+			for (int i = 0; i <= x; ++i) {
+				r.V[i] = mem[(r.I + i) & MEM_MASK];
+			}
+		}
+};
+
+namespace nAot
+{
+	struct sMachine {
+		sRegister	reg;
+		uint8_t		memory[MEM_SIZE] {};
+		uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+		uint8_t		delay_timer{};
+		uint8_t		sound_timer{};
+	};
+
+	// Entry point of a recompiled TU built with -DAOT_BENCH: runs the ROM
+	// through the interpreter and through the translated blocks from the same
+	// boot state, checks that both end in the same state and compares speed.
+	//
+	//   <aot binary> [-n frames]
+	inline int Bench (const sAotProgram &prog, int argc, char **argv) {
+		int frames = 100000;
+		if (argc > 2 && std::strcmp(argv[1], "-n") == 0) {
+			frames = std::atoi(argv[2]);
+		}
+		sMachine* m[2] = {new sMachine, new sMachine};
+		cCPU* cpu[2];
+		double seconds[2];
+		for (int k = 0; k < 2; ++k) {
+			cpu[k] = new cCPU(m[k]->reg, m[k]->memory, m[k]->delay_timer, m[k]->sound_timer, m[k]->frame_buffer);
+			cpu[k]->Seed(1);
+			cpu[k]->Boot(prog.image, prog.size);
+		}
+		cAot* aot = new cAot(*cpu[1], prog);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f) {
+			cpu[0]->RunFrame();
+		}
+		seconds[0] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		start = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f) {
+			aot->RunFrame();
+		}
+		seconds[1] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		sSnapshot* snap[2] = {new sSnapshot, new sSnapshot};
+		cpu[0]->SaveState(*snap[0]);
+		cpu[1]->SaveState(*snap[1]);
+		const bool same = snap[0]->reg.PC == snap[1]->reg.PC && snap[0]->reg.I == snap[1]->reg.I
+						  && !std::memcmp(snap[0]->reg.V, snap[1]->reg.V, sizeof snap[0]->reg.V)
+						  && !std::memcmp(snap[0]->memory, snap[1]->memory, MEM_SIZE)
+						  && !std::memcmp(snap[0]->frame_buffer, snap[1]->frame_buffer, DISP_WIDTH * DISP_HEIGHT)
+						  && snap[0]->cycle == snap[1]->cycle && snap[0]->stack_depth == snap[1]->stack_depth
+						  && snap[0]->delay_timer == snap[1]->delay_timer && snap[0]->fault == snap[1]->fault;
+
+		const long int total = aot->Native() + aot->Fallback();
+		printf("%-50s interp %8.2f MIPS  aot %8.2f MIPS  x%5.2f  native %5.1f%%  %d blocks dropped  %s\n", prog.name,
+			   cpu[0]->GetCycle() / seconds[0] / 1e6, cpu[1]->GetCycle() / seconds[1] / 1e6, seconds[0] / seconds[1],
+			   total ? 100.0 * aot->Native() / total : 0.0, aot->Invalidated(), same ? "match" : "MISMATCH");
+
+		delete snap[0];
+		delete snap[1];
+		delete aot;
+		for (int k = 0; k < 2; ++k) {
+			delete cpu[k];
+			delete m[k];
+		}
+		return same ? 0 : 1;
+	}
+}
+
+#endif
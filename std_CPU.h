@@ -0,0 +1,798 @@
+#pragma once
+
+#ifndef CPUCommon
+#define CPUCommon
+
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Opcode.h"
+#include "std_Timing.h"
+
+#define STACK_DEPTH	12
+#define STACK_SLOTS	16
+
+// Why a core stopped on its own. Faults are sticky until the next LoadState.
+enum eFault : uint8_t {
+	FAULT_NONE				= 0,
+	FAULT_STACK_OVERFLOW	= 1,
+	FAULT_STACK_UNDERFLOW	= 2,
+};
+
+// Behaviours that differ between CHIP-8 interpreters. With none set the core
+// behaves as it always has (the CHIP-48 / SUPER-CHIP reading); "vip" selects
+// the original COSMAC VIP interpreter's.
+enum eQuirk : uint8_t {
+	QUIRK_SHIFT_VY	= 0x01,	// 8xy6 / 8xyE shift Vy into Vx instead of shifting Vx
+	QUIRK_MEMORY_I	= 0x02,	// Fx55 / Fx65 leave I past the last register
+	QUIRK_JUMP_VX	= 0x04,	// Bxnn jumps to xnn + Vx instead of Bnnn to nnn + V0
+	QUIRK_VF_RESET	= 0x08,	// 8xy1 / 8xy2 / 8xy3 clear VF
+	QUIRK_VIP		= QUIRK_SHIFT_VY | QUIRK_MEMORY_I | QUIRK_VF_RESET,
+};
+
+struct sRegister {
+	uint16_t    PC{};
+	uint8_t     V[0x10] {};
+	uint16_t    I{};
+
+	void PrintRegisters () {
+		nDebug::LogValue("PC", PC);
+		nDebug::LogValue("I", I);
+		for (int i = 0; i < 0x10; ++i) {
+			nDebug::LogValue(nDebug::ConvertToString("V[", i, "]"), V[i]);
+		}
+		nDebug::LogInfo("");
+	}
+};
+
+// Everything needed to resume a machine exactly where it was.
+struct sSnapshot {
+	sRegister	reg;
+	uint8_t		memory[MEM_SIZE] {};
+	uint8_t		frame_buffer[DISP_HEIGHT * DISP_WIDTH] {};
+	uint8_t		delay_timer{};
+	uint8_t		sound_timer{};
+	uint16_t	stack[STACK_SLOTS] {};
+	uint8_t		stack_depth{};
+	uint8_t		fault{};
+	bool		keypad[16] {};
+	uint16_t	tapped{};
+	uint16_t	pending_release{};
+	uint32_t	rng_state{};
+	long int	cycle{};
+	bool		state = true;
+};
+
+class cCPU  {
+	private:
+		sRegister*  _reg{};
+		uint8_t*    _mem{};
+		uint8_t*    _delay{};
+		uint8_t*    _sound{};
+		uint8_t*    _disp{};
+		uint16_t    instr{};
+		uint16_t    NNN{};
+		uint8_t     NN{};
+		uint8_t     N{};
+		uint8_t     X{};
+		uint8_t     Y{};
+
+		bool state = true;
+		bool keypad[16]{};
+		bool key_pressed = false;
+		uint16_t tapped{};
+		uint16_t pending_release{};
+
+		// Every index into memory, the keypad and the stack is masked to its
+		// power-of-two size, so no opcode can reach outside the arrays. The
+		// stack has spare slots past STACK_DEPTH for the overflowing push.
+		uint16_t 	stack[STACK_SLOTS]{};
+		uint8_t		sp = 0;
+		uint8_t		fault = FAULT_NONE;
+
+		uint8_t X_coord, Y_coord, orig_X, randNum;
+
+		long int cycle = 0;
+		uint32_t rng_state = 1;
+		// Bumped whenever memory is replaced wholesale (Boot, LoadState) or
+		// touched behind a cache's back (Touch), so anything caching decoded
+		// code knows to start over.
+		uint32_t generation = 0;
+
+		// The timers are deadlines on the 60 Hz tick derived from cycle, not
+		// counters: a timer loaded with v at tick t reads max(0, t + v - now).
+		// Nothing has to run per frame to keep them going, and they stay at
+		// 60 Hz of emulated time whatever the host does with the clock. The
+		// bytes behind _delay and _sound are only refreshed when read.
+		long int timer_period = INST_PER_SEC / 60;
+		long int delay_until{};
+		long int sound_until{};
+
+		long int Tick () const {
+			return cycle / timer_period;
+		}
+
+		// Cycles each opcode adds, indexed by instr & cost_mask (see SetTiming).
+		const uint16_t*	cost = nTiming::FLAT_COST;
+		uint16_t		cost_mask = 0;
+		bool			display_wait = false;
+		uint8_t			quirks = 0;
+
+		sSnapshot	boot;
+
+		friend class cDebugger;
+		friend class cAot;
+		friend class cFusion;
+	public:
+		cCPU () {};
+
+		cCPU (sRegister &reg, uint8_t* mem, uint8_t &delay, uint8_t &sound, uint8_t* disp) : _reg(&reg), _mem(mem), _delay(&delay), _sound(&sound), _disp(disp) {
+			Seed(time(0));
+		}
+
+		// xorshift32 kept per core, so runs with the same seed are reproducible
+		// and several cores can run side by side on different threads.
+		void Seed (uint32_t seed) {
+			rng_state = seed ? seed : 0x2545F491;
+		}
+		uint32_t Random () {
+			rng_state ^= rng_state << 13;
+			rng_state ^= rng_state >> 17;
+			rng_state ^= rng_state << 5;
+			return rng_state;
+		}
+
+		void InitToRom () {
+			_reg->PC = ROM_ENTRYPOINT;
+		}
+
+		// Powers up a clean machine around image (zeroed memory and display,
+		// font, ROM at ROM_ENTRYPOINT, empty stack, stopped timers) and caches
+		// that state as the boot image Reset returns to.
+		void Boot (const uint8_t* image, size_t size) {
+			std::memset(_mem, 0, MEM_SIZE);
+			std::memset(_disp, 0, DISP_WIDTH * DISP_HEIGHT);
+			LoadFontToMem();
+			std::memcpy(&_mem[ROM_ENTRYPOINT], image, std::min<size_t>(size, MEM_SIZE - ROM_ENTRYPOINT));
+			*_reg = sRegister{};
+			InitToRom();
+			*_delay = *_sound = 0;
+			delay_until = sound_until = 0;
+			sp = 0;
+			fault = FAULT_NONE;
+			std::memset(keypad, 0, sizeof keypad);
+			tapped = pending_release = 0;
+			cycle = 0;
+			state = true;
+			generation++;
+			SaveState(boot);
+		}
+
+		// Back to the boot image: a block copy of memory, display and stack
+		// plus a handful of scalar stores, cheap enough to run per episode.
+		void Reset () {
+			LoadState(boot);
+		}
+
+		void LoadFontToMem () {
+			uint8_t font[80] = {
+				0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+				0x20, 0x60, 0x20, 0x20, 0x70, // 1
+				0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+				0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+				0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+				0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+				0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+				0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+				0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+				0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+				0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+				0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+				0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+				0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+				0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+				0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+			};
+
+			for (int i = 0x50; i < 0xA0; ++i) {
+				_mem[i] = font[i - 0x50];
+			}
+		}
+
+		// void DisplayFont () {
+		// 	for (int character = 0; character < 16; character++) {
+		// 		for (int row = 0; row < 5; row++) {
+		// 			unsigned char byte = _mem[0x50 + character * 5 + row];
+		// 			for (int bit = 7; bit >= 4; bit--) {
+		// 				if ((byte >> bit) & 1) {
+		// 					std::cout << "*";
+		// 				} else {
+		// 					std::cout << " ";
+		// 				}
+		// 			}
+		// 			std::cout << "\n";
+		// 		}
+		// 		std::cout << "\n";
+		// 	}
+		// }
+
+		void Fetch () { // BIG_ENDIAN
+			instr = _mem[_reg->PC & MEM_MASK] << 8;
+			instr |= _mem[(_reg->PC + 1) & MEM_MASK];
+			_reg->PC += 2;
+		}
+
+		void Decode () {
+			const sOpcode op(instr);
+			NNN = op.NNN;
+			NN = op.NN;
+			N = op.N;
+			X = op.X;
+			Y = op.Y;
+		}
+
+		void Draw (uint8_t x, uint8_t y, uint8_t n) {
+			X_coord = _reg->V[x] % DISP_WIDTH;
+			Y_coord = _reg->V[y] % DISP_HEIGHT;
+			orig_X = X_coord;
+			_reg->V[0xF] = 0;
+			for (uint8_t i = 0; i < n; i++) {
+				const uint8_t sprite_data = _mem[(_reg->I + i) & MEM_MASK];
+				X_coord = orig_X;
+				for (int8_t j = 7; j >= 0; j--) {
+					uint8_t *pixel = &_disp[Y_coord * DISP_WIDTH + X_coord];
+					const bool sprite_bit = (sprite_data & (1 << j));
+					if (sprite_bit && *pixel) {
+						_reg->V[0xF] = 1;
+					}
+					*pixel ^= sprite_bit;
+					if (++X_coord >= DISP_WIDTH)   break;
+				}
+				if (++Y_coord >= DISP_HEIGHT)  break;
+			}
+		}
+
+		void Execute () {
+			switch (instr >> 12) {
+				case (0x0):
+					if (NNN == 0x00E0) {
+						#ifdef DEBUG
+							nDebug::LogInfo("Clearing Screen");
+						#endif
+						std::memset(&_disp[0], false, sizeof *_disp);
+						break;
+					}
+					if (NNN == 0x00EE) {
+						#ifdef DEBUG
+							nDebug::LogInfo("Pop from stack");
+						#endif
+						// Branch-free: popping an empty stack faults and halts the core.
+						fault |= (sp == 0) * FAULT_STACK_UNDERFLOW;
+						sp -= (sp != 0);
+						_reg->PC = stack[sp & (STACK_SLOTS - 1)];
+						state &= !fault;
+						break;
+					}
+					#ifdef DEBUG
+						nDebug::LogInfo("Operation not implemented");
+						nDebug::LogValue("Instruction", instr);
+					#endif
+					break;
+				case (0x1):
+					#ifdef DEBUG
+						nDebug::LogInfo("Jumping to ", NNN);
+					#endif
+					_reg->PC = NNN;
+					break;
+				case (0x2):
+					#ifdef DEBUG
+						nDebug::LogInfo("Push to stack");
+					#endif
+					stack[sp & (STACK_SLOTS - 1)] = _reg->PC;
+					sp++;
+					fault |= (sp > STACK_DEPTH) * FAULT_STACK_OVERFLOW;
+					state &= !fault;
+					_reg->PC = NNN;
+					break;
+				case (0x3):
+					#ifdef DEBUG
+						nDebug::LogInfo("If V[", X,"] == ", NN, " skip instruction");
+					#endif
+					if(_reg->V[X] == NN) {
+						_reg->PC += 2;
+					}
+					break;
+				case (0x4):
+					#ifdef DEBUG
+						nDebug::LogInfo("If V[", X,"] != ", NN, " skip instruction");
+					#endif
+					if(_reg->V[X] != NN) {
+						_reg->PC += 2;
+					}
+					break;
+				case (0x5):
+					#ifdef DEBUG
+						nDebug::LogInfo("If V[", X,"] == V[", Y, "] skip instruction");
+					#endif
+					if(_reg->V[X] == _reg->V[Y]) {
+						_reg->PC += 2;
+					}
+					break;
+				case (0x6):
+					#ifdef DEBUG
+						nDebug::LogInfo("Setting V[", X,"] to ", NN);
+					#endif
+					_reg->V[X] = NN;
+					break;
+				case (0x7):
+					#ifdef DEBUG
+						nDebug::LogInfo("Adding ", NN," to V[", X,"]");
+					#endif
+					_reg->V[X] += NN;
+					break;
+				case (0x8):
+					switch (N) {
+						case (0x0):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] = V[", Y,"]");
+							#endif
+							_reg->V[X] = _reg->V[Y];
+							break;
+						case (0x1):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] |= V[", Y,"]");
+							#endif
+							_reg->V[X] |= _reg->V[Y];
+							if (quirks & QUIRK_VF_RESET) {
+								_reg->V[0xF] = 0;
+							}
+							break;
+						case (0x2):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] &= V[", Y,"]");
+							#endif
+							_reg->V[X] &= _reg->V[Y];
+							if (quirks & QUIRK_VF_RESET) {
+								_reg->V[0xF] = 0;
+							}
+							break;
+						case (0x3):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] XOR= V[", Y,"]");
+							#endif
+							_reg->V[X] ^= _reg->V[Y];
+							if (quirks & QUIRK_VF_RESET) {
+								_reg->V[0xF] = 0;
+							}
+							break;
+						case (0x4):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] += V[", Y,"]");
+							#endif
+							_reg->V[X] += _reg->V[Y];
+							if (_reg->V[X] < _reg->V[Y]) {
+								_reg->V[0xF] = 0x1;
+							}
+							break;
+						case (0x5):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] -= V[", Y,"]");
+							#endif
+							_reg->V[X] -= _reg->V[Y];
+							if (_reg->V[X] < _reg->V[Y]) {
+								_reg->V[0xF] = 0x1;
+							} else {
+								_reg->V[0xF] = 0x0;
+							}
+							break;
+						case (0x6):
+							#ifdef DEBUG
+								nDebug::LogInfo("Shift V[", X, "] right by 1. Set VF to LSB before shift.");
+							#endif
+							if (quirks & QUIRK_SHIFT_VY) {
+								_reg->V[X] = _reg->V[Y];
+							}
+							_reg->V[0xF] = _reg->V[X] & 0x01; // LSB before shift
+							_reg->V[X] >>= 1;
+							break;
+						case (0x7):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set -V[", X,"] -= V[", Y,"]");
+							#endif
+							_reg->V[X] = _reg->V[Y] - _reg->V[X];
+							if (_reg->V[Y] > _reg->V[X]) {
+								_reg->V[0xF] = 0x1;
+							} else {
+								_reg->V[0xF] = 0x0;
+							}
+							break;
+						case (0xE):
+							#ifdef DEBUG
+								nDebug::LogInfo("Shift V[", X, "] left by 1. Set VF to MSB before shift.");
+							#endif
+							if (quirks & QUIRK_SHIFT_VY) {
+								_reg->V[X] = _reg->V[Y];
+							}
+							_reg->V[0xF] = (_reg->V[X] & 0x80) >> 7; // MSB before shift
+							_reg->V[X] <<= 1;
+							break;
+					}	
+					break;
+				case (0x9):
+					#ifdef DEBUG
+						nDebug::LogInfo("If V[", X,"] != V[", Y, "] skip instruction");
+					#endif
+					if(_reg->V[X] != _reg->V[Y]) {
+						_reg->PC += 2;
+					}
+					break;
+				case (0xA):
+					#ifdef DEBUG
+						nDebug::LogInfo("Settting I to ", NNN);
+					#endif
+					_reg->I = NNN;
+					break;
+				case (0xB):
+					#ifdef DEBUG
+						nDebug::LogInfo("Jumping to ", NNN, " plus V[", (quirks & QUIRK_JUMP_VX) ? X : 0, "]");
+					#endif
+					_reg->PC = NNN + _reg->V[(quirks & QUIRK_JUMP_VX) ? X : 0];
+					break;
+				case (0xC):
+					#ifdef DEBUG
+						nDebug::LogInfo("Store random value in V[", X, "] binary ANDed with ", NN);
+					#endif
+					randNum = Random() % 0xFF;
+					randNum &= NN;
+					_reg->V[X] = randNum;
+					break;
+				case (0xD):
+					#ifdef DEBUG
+						nDebug::LogInfo("Drawing sprites");
+					#endif			
+					Draw(X, Y, N);
+					// The VIP draws right after its display interrupt, so a draw
+					// started mid-frame waits out the rest of it.
+					if (display_wait) {
+						cycle += (timer_period - cycle % timer_period) % timer_period;
+					}
+					break;
+				case (0xE):
+					if (NN == 0x9E) {
+						#ifdef DEBUG
+							nDebug::LogInfo("Skip next instruction if key V[", X, "] is pressed");
+						#endif
+						if (keypad[_reg->V[X] & 0x0F]) {
+							_reg->PC += 2;
+						}
+					} else if (NN == 0xA1) {
+						#ifdef DEBUG
+							nDebug::LogInfo("Skip next instruction if key V[", X, "] is not pressed");
+						#endif
+						if (!keypad[_reg->V[X] & 0x0F]) {
+							_reg->PC += 2;
+						}
+					} else {
+						#ifdef DEBUG
+							nDebug::LogInfo("Operation not implemented");
+							nDebug::LogValue("Instruction", instr);
+						#endif
+					}
+					break;
+				case (0xF):
+					switch (NN) {
+						case (0x1E):
+							#ifdef DEBUG
+								nDebug::LogInfo("Add V[", X,"] to I ", _reg->I);
+							#endif
+							_reg->I += _reg->V[X];
+							if (_reg->I > 0x1000) {
+								_reg->V[0xF] = 0x1;
+							}
+							break;
+						case (0x0A):
+							#ifdef DEBUG
+								nDebug::LogInfo("Wait for key press and store in V[", X, "]");
+							#endif
+							key_pressed = false;							
+							for (int i = 0; i < 16; ++i) {
+								if (keypad[i]) {
+									_reg->V[X] = i;
+									key_pressed = true;
+									#ifdef DEBUG
+										nDebug::LogInfo("Key pressed: ", i);
+									#endif
+									break;
+								}
+							}
+							if (!key_pressed) {
+								_reg->PC -= 2;
+							}
+							break;
+						case (0x07):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set V[", X,"] to delay timer value");
+							#endif
+							_reg->V[X] = DelayTimer();
+							break;
+						case (0x15):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set delay timer to V[", X,"]");
+							#endif
+							SetDelayTimer(_reg->V[X]);
+							break;
+						case (0x18):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set sound timer to V[", X,"]");
+							#endif
+							SetSoundTimer(_reg->V[X]);
+							break;
+						case (0x29):
+							#ifdef DEBUG
+								nDebug::LogInfo("Set I to the location of the sprite for digit V[", X,"]");
+							#endif
+							_reg->I = _reg->V[X] * 5 + 0x50;
+							break;
+						case (0x33):
+							#ifdef DEBUG
+								nDebug::LogInfo("Store BCD of V[", X,"] in memory locations I, I+1, I+2");
+							#endif
+							_mem[_reg->I & MEM_MASK] = _reg->V[X] / 100;
+							_mem[(_reg->I + 1) & MEM_MASK] = (_reg->V[X] / 10) % 10;
+							_mem[(_reg->I + 2) & MEM_MASK] = _reg->V[X] % 10;
+							break;
+						case (0x55):
+							#ifdef DEBUG
+								nDebug::LogInfo("Store registers V[0] to V[", X,"] in memory starting at I");
+							#endif
+							for (int i = 0; i <= X; ++i) {
+								_mem[(_reg->I + i) & MEM_MASK] = _reg->V[i];
+							}
+							if (quirks & QUIRK_MEMORY_I) {
+								_reg->I += X + 1;
+							}
+							break;
+						case (0x65):
+							#ifdef DEBUG
+								nDebug::LogInfo("Fill registers V[0] to V[", X,"] with values from memory starting at I");
+							#endif
+							for (int i = 0; i <= X; ++i) {
+								_reg->V[i] = _mem[(_reg->I + i) & MEM_MASK];
+							}
+							if (quirks & QUIRK_MEMORY_I) {
+								_reg->I += X + 1;
+							}
+							break;
+					}
+					break;
+				default:
+					#ifdef DEBUG
+						nDebug::LogInfo("Operation not implemented");
+						nDebug::LogValue("Instruction", instr);
+					#endif
+					break;
+			}
+		}
+		
+		// Keypad edges come straight from the host's key events. A key that is
+		// pressed and released inside one frame stays down until LatchInputs,
+		// so Ex9E and Fx0A still get to see the tap.
+		void SetKey (uint8_t key, bool down) {
+			const uint16_t bit = 1 << (key & 0x0F);
+			if (down) {
+				keypad[key & 0x0F] = true;
+				tapped |= bit;
+				pending_release &= ~bit;
+			} else if (tapped & bit) {
+				pending_release |= bit;
+			} else {
+				keypad[key & 0x0F] = false;
+			}
+		}
+		void LatchInputs () {
+			for (int i = 0; i < 16; ++i) {
+				if (pending_release & (1 << i)) {
+					keypad[i] = false;
+				}
+			}
+			tapped = pending_release = 0;
+		}
+
+		// Cycles per 60 Hz timer tick, normally the frame budget. The
+		// running timers keep their current values across the change.
+		void SetTimerPeriod (int cycles) {
+			const uint8_t delay = DelayTimer(), sound = SoundTimer();
+			timer_period = std::max(1, cycles);
+			SetDelayTimer(delay);
+			SetSoundTimer(sound);
+		}
+		uint8_t DelayTimer () {
+			return *_delay = std::max<long int>(0, delay_until - Tick());
+		}
+		uint8_t SoundTimer () {
+			return *_sound = std::max<long int>(0, sound_until - Tick());
+		}
+		void SetDelayTimer (uint8_t value) {
+			delay_until = Tick() + value;
+			*_delay = value;
+		}
+		void SetSoundTimer (uint8_t value) {
+			sound_until = Tick() + value;
+			*_sound = value;
+		}
+
+		// Selects what a cycle is. Under TIMING_VIP the frame budget and the
+		// timer period should be VIP_CYCLES_PER_FRAME. cAot and cFusion count
+		// instructions and assume TIMING_FLAT.
+		void SetTiming (eTiming timing) {
+			const bool vip = (timing == TIMING_VIP);
+			cost = vip ? nTiming::VipTable() : nTiming::FLAT_COST;
+			cost_mask = vip ? 0xFFFF : 0;
+			display_wait = vip;
+		}
+
+		// eQuirk flags. cAot assumes none are set; cFusion handles them.
+		void SetQuirks (uint8_t quirks) {
+			this->quirks = quirks;
+		}
+
+		// A comma-separated list of shift, memory, jump and vf_reset, or one
+		// of "none" and "vip".
+		static bool ParseQuirks (const char* list, uint8_t &quirks) {
+			const char* const names[] = {"shift", "memory", "jump", "vf_reset"};
+			quirks = 0;
+			std::stringstream in(list);
+			for (std::string name; std::getline(in, name, ','); ) {
+				bool known = false;
+				for (int i = 0; i < 4; ++i) {
+					if (name == names[i]) {
+						quirks |= 1 << i;
+						known = true;
+					}
+				}
+				if (name == "vip") {
+					quirks |= QUIRK_VIP;
+				} else if (name != "none" && !known) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Runs until cycle reaches end or the core stops.
+		void RunUntil (long int end) {
+			while (cycle < end && state) {
+				Run();
+			}
+		}
+
+		// One 60 Hz frame with no host attached: up to the next multiple of
+		// budget cycles, then the end-of-frame input latch. Frames stay on that
+		// grid even when an instruction runs past the end of one.
+		void RunFrame (int budget = INST_PER_SEC / 60) {
+			RunUntil(cycle - cycle % budget + budget);
+			LatchInputs();
+		}
+
+		void Run () {
+			GetState();
+			if (!state) {
+				return;
+			}
+			#ifdef DEBUG
+				nDebug::LogInfo("Step: ", cycle);
+			#endif
+
+			Fetch();			
+			Decode();
+			Execute();
+			cycle += cost[instr & cost_mask];
+
+			#ifdef DEBUG
+				nDebug::LogInfo("");
+			#endif
+		}
+
+		void PrintRegisters () {
+			nDebug::LogValue("Instr", instr);
+			nDebug::LogValue("NNN", NNN);
+			nDebug::LogValue("NN", NN);
+			nDebug::LogValue("N", N);
+			nDebug::LogValue("X", X);
+			nDebug::LogValue("Y", Y);
+			nDebug::LogInfo("");
+
+			_reg->PrintRegisters();
+		}
+
+		void MemDump () {
+			for (int i = 0; i < 4 * ONE_K; ++i) {
+				if ((i % 16) == 0) {
+					std::cout << std::setfill('0') << std::setw(4) << i <<": ";
+					for (int j = 0; j < 16; ++j) {
+						std::cout << std::setfill('0') << std::setw(2) << std::hex << static_cast<int> (_mem[i + j]) << " ";
+					}
+					std::cout << std::endl;
+				}
+			}
+		}
+
+		// void DispDump() {
+		// 	for (int y = 0; y < DISP_HEIGHT; ++y) {
+		// 		for (int x = 0; x < DISP_WIDTH; ++x) {
+		// 			if (_disp[y * DISP_WIDTH + x]) {
+		// 				std::cout << "*";
+		// 			} else {
+		// 				std::cout << " ";
+		// 			}
+		// 		}
+		// 		std::cout << std::endl;
+		// 	}
+		// }
+
+		// A faulted core cannot be resumed, only reloaded.
+		void SetState (bool state) {
+			this->state = state && !fault;
+		}
+		bool GetState () {
+			return state;
+		}
+		// Memory may have changed without cFusion seeing it: written by the
+		// debugger or cheats, or by instructions run through Run directly.
+		void Touch () {
+			generation++;
+		}
+
+		long int GetCycle () const {
+			return cycle;
+		}
+		int GetStackDepth () const {
+			return std::min<int>(sp, STACK_SLOTS);
+		}
+		uint8_t GetFault () const {
+			return fault;
+		}
+		uint16_t GetKeypad () const {
+			uint16_t mask = 0;
+			for (int i = 0; i < 16; ++i) {
+				mask |= keypad[i] << i;
+			}
+			return mask;
+		}
+
+		void SaveState (sSnapshot &snap) {
+			snap.reg = *_reg;
+			std::memcpy(snap.memory, _mem, sizeof snap.memory);
+			std::memcpy(snap.frame_buffer, _disp, sizeof snap.frame_buffer);
+			snap.delay_timer = DelayTimer();
+			snap.sound_timer = SoundTimer();
+			std::memcpy(snap.stack, stack, sizeof snap.stack);
+			snap.stack_depth = GetStackDepth();
+			snap.fault = fault;
+			std::memcpy(snap.keypad, keypad, sizeof snap.keypad);
+			snap.tapped = tapped;
+			snap.pending_release = pending_release;
+			snap.rng_state = rng_state;
+			snap.cycle = cycle;
+			snap.state = state;
+		}
+		void LoadState (const sSnapshot &snap) {
+			*_reg = snap.reg;
+			std::memcpy(_mem, snap.memory, sizeof snap.memory);
+			std::memcpy(_disp, snap.frame_buffer, sizeof snap.frame_buffer);
+			std::memcpy(stack, snap.stack, sizeof stack);
+			sp = std::min<int>(snap.stack_depth, STACK_SLOTS);
+			fault = snap.fault;
+			std::memcpy(keypad, snap.keypad, sizeof keypad);
+			tapped = snap.tapped;
+			pending_release = snap.pending_release;
+			rng_state = snap.rng_state;
+			cycle = snap.cycle;
+			state = snap.state;
+			generation++;
+			SetDelayTimer(snap.delay_timer);
+			SetSoundTimer(snap.sound_timer);
+		}
+
+};
+
+#endif
\ No newline at end of file
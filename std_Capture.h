@@ -0,0 +1,335 @@
+#pragma once
+
+#ifndef CaptureCommon
+#define CaptureCommon
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+
+#define CAPTURE_QUEUE	32
+#define CAPTURE_SCALE	8
+
+enum eCaptureJob : uint8_t {
+	JOB_SCREENSHOT,
+	JOB_VIDEO_START,
+	JOB_VIDEO_FRAME,
+	JOB_VIDEO_STOP,
+};
+
+struct sCaptureJob {
+	eCaptureJob	type{};
+	char		path[256] {};
+	int			scale{};
+	uint8_t		frame[DISP_WIDTH * DISP_HEIGHT] {};
+	uint32_t	color[DISP_WIDTH * DISP_HEIGHT] {};
+};
+
+namespace nEncode
+{
+	inline uint32_t Crc32 (uint32_t crc, const uint8_t* data, size_t len) {
+		static uint32_t table[256];
+		static bool ready = false;
+		if (!ready) {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				table[n] = c;
+			}
+			ready = true;
+		}
+		crc = ~crc;
+		for (size_t i = 0; i < len; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	inline void PutBE32 (std::string &out, uint32_t v) {
+		out.push_back(v >> 24);
+		out.push_back(v >> 16);
+		out.push_back(v >> 8);
+		out.push_back(v);
+	}
+
+	inline void PngChunk (FILE* f, const char* type, const std::string &data) {
+		std::string chunk(type, 4);
+		chunk += data;
+		std::string len;
+		PutBE32(len, data.size());
+		std::string crc;
+		PutBE32(crc, Crc32(0, (const uint8_t*) chunk.data(), chunk.size()));
+		fwrite(len.data(), 1, 4, f);
+		fwrite(chunk.data(), 1, chunk.size(), f);
+		fwrite(crc.data(), 1, 4, f);
+	}
+
+	// RGBA8 PNG of width x height 0xRRGGBBAA pixels. The zlib stream uses stored
+	// blocks only: these images are tiny and it keeps the writer dependency-free.
+	inline bool WritePNG (const char* path, const uint32_t* rgba, int width, int height) {
+		FILE* f = fopen(path, "wb");
+		if (!f) {
+			return false;
+		}
+
+		std::string raw;
+		raw.reserve((width * 4 + 1) * height);
+		for (int y = 0; y < height; ++y) {
+			raw.push_back(0);
+			for (int x = 0; x < width; ++x) {
+				PutBE32(raw, rgba[y * width + x]);
+			}
+		}
+
+		std::string z = "\x78\x01";
+		uint32_t a = 1, b = 0;
+		for (size_t pos = 0; pos < raw.size() || pos == 0; ) {
+			const size_t len = std::min<size_t>(raw.size() - pos, 0xFFFF);
+			const bool last = pos + len == raw.size();
+			z.push_back(last);
+			z.push_back(len & 0xFF);
+			z.push_back(len >> 8);
+			z.push_back(~len & 0xFF);
+			z.push_back((~len >> 8) & 0xFF);
+			z.append(raw, pos, len);
+			for (size_t i = pos; i < pos + len; ++i) {
+				a = (a + (uint8_t) raw[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			pos += len;
+			if (last) {
+				break;
+			}
+		}
+		PutBE32(z, (b << 16) | a);
+
+		std::string ihdr;
+		PutBE32(ihdr, width);
+		PutBE32(ihdr, height);
+		ihdr += std::string("\x08\x06\x00\x00\x00", 5);
+
+		fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+		PngChunk(f, "IHDR", ihdr);
+		PngChunk(f, "IDAT", z);
+		PngChunk(f, "IEND", "");
+		fclose(f);
+		return true;
+	}
+
+	// Lossless 1-bit frame as alternating off/on run lengths, starting with
+	// an off run. Runs longer than 255 are split with zero-length runs.
+	inline void WriteRLEFrame (FILE* f, const uint8_t* frame) {
+		uint8_t out[DISP_WIDTH * DISP_HEIGHT * 2 + 2];
+		size_t n = 0;
+		uint8_t value = 0;
+		int run = 0;
+		for (int i = 0; i <= DISP_WIDTH * DISP_HEIGHT; ++i) {
+			const bool end = (i == DISP_WIDTH * DISP_HEIGHT);
+			if (!end && (frame[i] != 0) == value) {
+				if (++run == 255) {
+					out[n++] = 255;
+					out[n++] = 0;
+					run = 0;
+				}
+				continue;
+			}
+			out[n++] = run;
+			if (end) {
+				break;
+			}
+			value ^= 1;
+			run = 1;
+		}
+		const uint16_t size = n;
+		fwrite(&size, sizeof size, 1, f);
+		fwrite(out, 1, n, f);
+	}
+
+	inline void WriteY4MFrame (FILE* f, const uint8_t* frame, int scale) {
+		const int w = DISP_WIDTH * scale, h = DISP_HEIGHT * scale;
+		std::string plane(w * h, 16);
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				if (frame[(y / scale) * DISP_WIDTH + x / scale]) {
+					plane[y * w + x] = (char) 235;
+				}
+			}
+		}
+		fputs("FRAME\n", f);
+		fwrite(plane.data(), 1, plane.size(), f);
+		const std::string chroma(w * h / 2, (char) 128);
+		fwrite(chroma.data(), 1, chroma.size(), f);
+	}
+}
+
+// Screenshot and video capture. The emulation thread only copies the frame
+// into a bounded queue; encoding and disk I/O happen on a worker thread, and
+// a full queue drops the frame rather than stalling the caller.
+class cCapture {
+	private:
+		sCaptureJob*			queue{};
+		int						head = 0;
+		int						count = 0;
+		std::mutex				lock;
+		std::condition_variable	wake;
+		std::thread				worker;
+		bool					stopping = false;
+
+		bool		recording = false;
+		uint32_t	dropped = 0;
+		uint32_t	screenshots = 0;
+
+		FILE*		video{};
+		bool		video_rle = false;
+		int			video_scale{};
+
+		void Worker () {
+			sCaptureJob* job = new sCaptureJob;
+			while (true) {
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [this] { return count > 0 || stopping; });
+					if (count == 0) {
+						break;
+					}
+					*job = queue[head];
+					head = (head + 1) % CAPTURE_QUEUE;
+					count--;
+				}
+				Encode(*job);
+			}
+			delete job;
+		}
+
+		void Encode (const sCaptureJob &job) {
+			switch (job.type) {
+				case (JOB_SCREENSHOT): {
+					const int w = DISP_WIDTH * CAPTURE_SCALE, h = DISP_HEIGHT * CAPTURE_SCALE;
+					std::vector<uint32_t> rgba(w * h);
+					for (int y = 0; y < h; ++y) {
+						for (int x = 0; x < w; ++x) {
+							rgba[y * w + x] = job.color[(y / CAPTURE_SCALE) * DISP_WIDTH + x / CAPTURE_SCALE];
+						}
+					}
+					if (!nEncode::WritePNG(job.path, rgba.data(), w, h)) {
+						nDebug::LogError("Unable to write screenshot");
+					}
+					break;
+				}
+				case (JOB_VIDEO_START):
+					video = fopen(job.path, "wb");
+					if (!video) {
+						nDebug::LogError("Unable to open video capture file");
+						break;
+					}
+					video_rle = std::strstr(job.path, ".y4m") == nullptr;
+					video_scale = job.scale;
+					if (video_rle) {
+						fwrite("C8V1", 1, 4, video);
+					} else {
+						fprintf(video, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n",
+								DISP_WIDTH * video_scale, DISP_HEIGHT * video_scale);
+					}
+					break;
+				case (JOB_VIDEO_FRAME):
+					if (!video) {
+						break;
+					}
+					if (video_rle) {
+						nEncode::WriteRLEFrame(video, job.frame);
+					} else {
+						nEncode::WriteY4MFrame(video, job.frame, video_scale);
+					}
+					break;
+				case (JOB_VIDEO_STOP):
+					if (video) {
+						fclose(video);
+						video = nullptr;
+					}
+					break;
+			}
+		}
+
+		bool Push (eCaptureJob type, const char* path, const uint8_t* frame, const uint32_t* color, int scale = 0) {
+			std::lock_guard<std::mutex> guard(lock);
+			if (count == CAPTURE_QUEUE) {
+				dropped++;
+				return false;
+			}
+			sCaptureJob &job = queue[(head + count) % CAPTURE_QUEUE];
+			job.type = type;
+			job.scale = scale;
+			if (path) {
+				snprintf(job.path, sizeof job.path, "%s", path);
+			}
+			if (frame) {
+				std::memcpy(job.frame, frame, sizeof job.frame);
+			}
+			if (color) {
+				std::memcpy(job.color, color, sizeof job.color);
+			}
+			count++;
+			wake.notify_one();
+			return true;
+		}
+
+	public:
+		cCapture () {
+			queue = new sCaptureJob[CAPTURE_QUEUE];
+			worker = std::thread(&cCapture::Worker, this);
+		}
+		~cCapture () {
+			StopVideo();
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			wake.notify_one();
+			worker.join();
+			delete[] queue;
+			if (dropped) {
+				nDebug::LogInfo("Capture dropped ", dropped, " frames");
+			}
+		}
+
+		bool Recording () const {
+			return recording;
+		}
+
+		// Writes a PNG of the colour buffer, CAPTURE_SCALE times the native size.
+		void Screenshot (const uint32_t* color, const char* path = nullptr) {
+			char name[64];
+			if (path == nullptr) {
+				snprintf(name, sizeof name, "screenshot_%ld_%u.png", (long) time(nullptr), screenshots++);
+				path = name;
+			}
+			Push(JOB_SCREENSHOT, path, nullptr, color);
+		}
+
+		// A path ending in .y4m records scaled YUV4MPEG2, anything else 1-bit RLE.
+		void StartVideo (const char* path, int scale = 4) {
+			StopVideo();
+			recording = Push(JOB_VIDEO_START, path, nullptr, nullptr, std::max(2, scale & ~1));
+		}
+		void StopVideo () {
+			if (recording) {
+				// The stop marker must not be dropped or the file would never be closed.
+				while (!Push(JOB_VIDEO_STOP, nullptr, nullptr, nullptr)) {
+					std::this_thread::yield();
+				}
+				recording = false;
+			}
+		}
+
+		void Frame (const uint8_t* frame) {
+			if (recording) {
+				Push(JOB_VIDEO_FRAME, nullptr, frame, nullptr);
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,188 @@
+#pragma once
+
+#ifndef CheatCommon
+#define CheatCommon
+
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+
+#define CHEAT_MAX	64
+
+// Relations a RAM search filter keeps, comparing each byte with the snapshot
+// taken at the previous filter (or with a fixed value for SEARCH_VALUE).
+enum eSearch {
+	SEARCH_UNCHANGED,
+	SEARCH_CHANGED,
+	SEARCH_INCREASED,
+	SEARCH_DECREASED,
+	SEARCH_VALUE,
+};
+
+// Narrows the 4 KB of memory down to the bytes that behave like a score,
+// a life counter, a timer... Candidates are a byte mask (0xFF = still in)
+// so each filter is a handful of whole-vector compares over the address
+// space rather than a branch per byte.
+class cRamSearch {
+	private:
+		typedef uint8_t tVec __attribute__((vector_size(16)));
+
+		const uint8_t*	_mem{};
+		alignas(16) uint8_t	previous[MEM_SIZE] {};
+		alignas(16) uint8_t	candidates[MEM_SIZE] {};
+
+		static tVec Load (const uint8_t* p) {
+			tVec v;
+			std::memcpy(&v, p, sizeof v);
+			return v;
+		}
+
+	public:
+		cRamSearch () {};
+		cRamSearch (const uint8_t* mem) : _mem(mem) {};
+
+		// Every address is a candidate again, measured from memory as it is now.
+		void Start () {
+			std::memcpy(previous, _mem, MEM_SIZE);
+			std::memset(candidates, 0xFF, MEM_SIZE);
+		}
+
+		static bool ParseRelation (const std::string &name, eSearch &relation) {
+			const char* const names[] = {"eq", "ne", "gt", "lt", "="};
+			for (int i = 0; i <= SEARCH_VALUE; ++i) {
+				if (name == names[i]) {
+					relation = (eSearch) i;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Drops every candidate whose current byte does not satisfy relation,
+		// then makes the current memory the new reference. Returns the count left.
+		int Filter (eSearch relation, uint8_t value = 0) {
+			const tVec match = tVec{} + value;
+			for (int i = 0; i < MEM_SIZE; i += sizeof(tVec)) {
+				const tVec now = Load(&_mem[i]);
+				const tVec before = Load(&previous[i]);
+				tVec keep;
+				switch (relation) {
+					case (SEARCH_UNCHANGED):	keep = (tVec) (now == before); break;
+					case (SEARCH_CHANGED):		keep = (tVec) (now != before); break;
+					case (SEARCH_INCREASED):	keep = (tVec) (now > before); break;
+					case (SEARCH_DECREASED):	keep = (tVec) (now < before); break;
+					default:					keep = (tVec) (now == match); break;
+				}
+				const tVec kept = Load(&candidates[i]) & keep;
+				std::memcpy(&candidates[i], &kept, sizeof kept);
+				std::memcpy(&previous[i], &now, sizeof now);
+			}
+			return Count();
+		}
+
+		int Count () const {
+			int count = 0;
+			for (int i = 0; i < MEM_SIZE; i += 8) {
+				uint64_t word;
+				std::memcpy(&word, &candidates[i], 8);
+				count += __builtin_popcountll(word);
+			}
+			return count / 8;
+		}
+
+		// Fills out with up to max candidate addresses, lowest first.
+		int List (uint16_t* out, int max) const {
+			int n = 0;
+			for (int i = 0; i < MEM_SIZE && n < max; ++i) {
+				if (candidates[i]) {
+					out[n++] = i;
+				}
+			}
+			return n;
+		}
+};
+
+struct sCheat {
+	uint16_t	addr;
+	uint8_t		value;
+};
+
+// Freeze cheats, written back after every instruction. The main loop only
+// takes the path that calls Apply while Active() is true.
+class cCheats {
+	private:
+		uint8_t*	_mem{};
+		sCheat		freezes[CHEAT_MAX] {};
+		int			count = 0;
+
+	public:
+		cCheats () {};
+		cCheats (uint8_t* mem) : _mem(mem) {};
+
+		bool Active () const {
+			return count != 0;
+		}
+
+		void Apply () {
+			for (int i = 0; i < count; ++i) {
+				_mem[freezes[i].addr] = freezes[i].value;
+			}
+		}
+
+		bool Freeze (uint16_t addr, uint8_t value) {
+			addr &= MEM_MASK;
+			for (int i = 0; i < count; ++i) {
+				if (freezes[i].addr == addr) {
+					freezes[i].value = value;
+					return true;
+				}
+			}
+			if (count == CHEAT_MAX) {
+				return false;
+			}
+			freezes[count++] = {addr, value};
+			_mem[addr] = value;
+			return true;
+		}
+		void Unfreeze (uint16_t addr) {
+			for (int i = 0; i < count; ++i) {
+				if (freezes[i].addr == (addr & MEM_MASK)) {
+					freezes[i] = freezes[--count];
+					return;
+				}
+			}
+		}
+		void Poke (uint16_t addr, uint8_t value) {
+			_mem[addr & MEM_MASK] = value;
+		}
+		void Clear () {
+			count = 0;
+		}
+
+		int Count () const {
+			return count;
+		}
+		const sCheat& Get (int i) const {
+			return freezes[i];
+		}
+
+		// "<hex addr>:<hex value>" pairs separated by spaces or commas, as in
+		// the cheats config key.
+		static bool ParseList (const std::string &list, std::vector<sCheat> &out) {
+			std::string items = list;
+			std::replace(items.begin(), items.end(), ',', ' ');
+			std::istringstream in(items);
+			std::string item;
+			while (in >> item) {
+				unsigned int addr, value;
+				char extra;
+				if (sscanf(item.c_str(), "%x:%x%c", &addr, &value, &extra) != 2 || addr >= MEM_SIZE || value > 0xFF) {
+					return false;
+				}
+				out.push_back({(uint16_t) addr, (uint8_t) value});
+			}
+			return (int) out.size() <= CHEAT_MAX;
+		}
+};
+
+#endif
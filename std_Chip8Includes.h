@@ -18,5 +18,7 @@
 #define LERP_RATE   0.7f
 
 #define ROM_ENTRYPOINT  0x200
+#define MEM_SIZE        0x1000
+#define MEM_MASK        (MEM_SIZE - 1)
 
 #endif
\ No newline at end of file
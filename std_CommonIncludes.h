@@ -12,40 +12,66 @@
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include "std_Log.h"
 
 #define ONE_K 1024
 #define ONE_M 1024 * 1024
 
+namespace nHash
+{
+	// 64-bit FNV-1a; used for frame checkpoints and ROM identity.
+	inline uint64_t Fnv1a (const uint8_t* data, size_t len, uint64_t hash = 0xcbf29ce484222325ull) {
+		for (size_t i = 0; i < len; ++i) {
+			hash = (hash ^ data[i]) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
 namespace nDebug
 {
-	void LogInfo (const std::string &s)	{
-		std::cout << s << "\n";
+	// Thin front end over the asynchronous logger in std_Log.h: the message is
+	// formatted into the calling thread's line and the call returns without I/O.
+	inline void LogInfo (std::string_view s)	{
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(s));
 	}	
-	void LogInfo (const std::string &s, int val) {
-		std::cout << s << val << "\n";
+	inline void LogInfo (std::string_view s, int val) {
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(s).Int(val));
 	}
-	void LogInfo (const std::string &s0, int val0, const std::string &s1) {
-		std::cout << s0 << val0 << s1 << "\n";
+	inline void LogInfo (std::string_view s0, int val0, std::string_view s1) {
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(s0).Int(val0).Str(s1));
 	}
-	void LogInfo (const std::string &s0, int val0, const std::string &s1, int val1)	{
-		std::cout << s0 << val0 << s1 << val1 << "\n";
+	inline void LogInfo (std::string_view s0, int val0, std::string_view s1, int val1)	{
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(s0).Int(val0).Str(s1).Int(val1));
 	}
-	void LogInfo (const std::string &s0, int val0, const std::string &s1, int val1, const std::string &s2)	{
-		std::cout << s0 << val0 << s1 << val1 << s2 << "\n";
+	inline void LogInfo (std::string_view s0, int val0, std::string_view s1, int val1, std::string_view s2)	{
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(s0).Int(val0).Str(s1).Int(val1).Str(s2));
 	}
 
-	void LogError (const std::string &s)	{
-		std::cerr << s << "\n";
+	inline void LogDebug (std::string_view s)	{
+		nLog::Logger().Submit(LOG_DEBUG, nLog::Line().Str(s));
+	}
+	inline void LogWarn (std::string_view s)	{
+		nLog::Logger().Submit(LOG_WARN, nLog::Line().Str(s));
+	}
+	inline void LogError (std::string_view s)	{
+		nLog::Logger().Submit(LOG_ERROR, nLog::Line().Str(s));
 	}
 
-	void LogValue (const std::string &regname, uint32_t reg)	{
-		std::cout << regname << ":\t0x" << std::setfill('0') << std::setw(8) << std::hex << reg << "\n";
+	inline void LogValue (std::string_view regname, uint32_t reg)	{
+		nLog::Logger().Submit(LOG_INFO, nLog::Line().Str(regname).Str(":\t0x").Hex(reg, 8));
 	}
 	
-	std::string ConvertToString (const std::string &s1, int val, const std::string &s2) {
-	    std::stringstream ss;
-        ss << s1 << std::hex << std::uppercase << val << s2;
-        return ss.str();
+	inline std::string ConvertToString (std::string_view s1, int val, std::string_view s2) {
+		char hex[16];
+		snprintf(hex, sizeof hex, "%X", val);
+		return std::string(s1) + hex + std::string(s2);
+	}
+
+	// Waits for the writer thread; use before printing around the logger.
+	inline void Flush () {
+		nLog::Logger().Flush();
 	}
 }
 
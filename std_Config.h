@@ -0,0 +1,251 @@
+#pragma once
+
+#ifndef ConfigCommon
+#define ConfigCommon
+
+#include <fstream>
+#include <vector>
+#include <map>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Scaler.h"
+#include "std_CPU.h"
+#include "std_RunAhead.h"
+#include "std_Cheat.h"
+#include "std_Timing.h"
+#include "std_Library.h"
+
+#define CONFIG_FILE	"chip8.cfg"
+
+// Runtime settings. The macros in std_Chip8Includes.h are only the defaults.
+struct sConfig {
+	int			win_width = DISP_WIDTH * DISP_FACTOR;
+	int			win_height = DISP_HEIGHT * DISP_FACTOR;
+	eFilter		filter = OUTLINES ? FILTER_OUTLINE : FILTER_NEAREST;
+	uint32_t	fg_color = FG_COLOR;
+	uint32_t	bg_color = BG_COLOR;
+	float		lerp_rate = LERP_RATE;
+	int			inst_per_sec = INST_PER_SEC;
+	eTiming		timing = TIMING_FLAT;	// vip: per-opcode VIP cycle costs instead of inst_per_sec
+	bool		fusion = false;			// run through cFusion; flat timing only
+	uint8_t		quirks = 0;				// eQuirk flags, usually in a [rom] section
+	float		frame_ms = DELAY_MS;
+	int			input_slices = 1;	// times per frame the event queue is drained between CPU slices
+	int			runahead = 0;		// frames presented ahead of the real timeline
+	std::string	bindings;
+	eLogLevel	log_level = LOG_INFO;
+	bool		debug = false;
+	std::string	video;
+	std::string	socket;
+	std::string	shm;
+	std::string	cheats;			// "<addr>:<value>" freezes, usually in a [rom] section
+	std::string	coverage;		// path prefix for the coverage .png / .txt written at exit
+	std::string	library;		// ';'-separated directories the ROM picker (F2) indexes
+	std::string	library_cache = LIBRARY_CACHE;
+	std::string	net_peer;			// "host:port"; netplay is on when set
+	int			net_port = 7000;
+	int			net_delay = 2;		// frames of local input delay
+	float		net_latency = 0;	// ms, shim on outgoing packets
+	float		net_jitter = 0;
+	float		net_loss = 0;		// fraction of outgoing packets dropped
+};
+
+struct sSetting {
+	std::string	key;
+	std::string	value;
+};
+
+// Settings come in layers: built-in defaults, the config file's global
+// lines, the file's [rom <hash>] section for the ROM being loaded, then the
+// command line. Resolve flattens them once per ROM load; nothing looks a
+// setting up while the emulator runs.
+//
+// Config file: "key = value" lines, '#' comments, and "[rom <fnv1a hex>]"
+// headers that start a per-ROM section.
+class cConfig {
+	private:
+		std::vector<sSetting>						global;
+		std::map<uint64_t, std::vector<sSetting>>	per_rom;
+		std::vector<sSetting>						args;
+		bool										file_loaded = false;
+
+		static std::string Trim (const std::string &s) {
+			const size_t begin = s.find_first_not_of(" \t\r");
+			const size_t end = s.find_last_not_of(" \t\r");
+			return (begin == std::string::npos) ? "" : s.substr(begin, end - begin + 1);
+		}
+
+	public:
+		cConfig () {};
+
+		// Applies one setting; false if the key is unknown or the value does not parse.
+		static bool Apply (sConfig &config, const std::string &key, const std::string &value) {
+			const char* v = value.c_str();
+			char* end = nullptr;
+			if (key == "size") {
+				return sscanf(v, "%dx%d", &config.win_width, &config.win_height) == 2
+					&& config.win_width > 0 && config.win_height > 0;
+			} else if (key == "filter") {
+				return cScaler::ParseFilter(v, config.filter);
+			} else if (key == "fg" || key == "bg") {
+				const uint32_t color = std::strtoul(v, &end, 16);
+				(key == "fg" ? config.fg_color : config.bg_color) = color;
+				return *v && *end == '\0';
+			} else if (key == "lerp") {
+				config.lerp_rate = std::clamp(std::strtof(v, &end), 0.0f, 1.0f);
+			} else if (key == "ips") {
+				config.inst_per_sec = std::max(60l, std::strtol(v, &end, 10));
+			} else if (key == "timing") {
+				return nTiming::ParseTiming(v, config.timing);
+			} else if (key == "quirks") {
+				return cCPU::ParseQuirks(v, config.quirks);
+			} else if (key == "fusion") {
+				config.fusion = std::strtol(v, &end, 10) != 0;
+			} else if (key == "frame_ms") {
+				config.frame_ms = std::max(0.0f, std::strtof(v, &end));
+			} else if (key == "slices") {
+				config.input_slices = std::max(1l, std::strtol(v, &end, 10));
+			} else if (key == "runahead") {
+				config.runahead = std::clamp(std::strtol(v, &end, 10), 0l, (long) RUNAHEAD_MAX);
+			} else if (key == "keys") {
+				config.bindings = value;
+				return true;
+			} else if (key == "log") {
+				return cLogger::ParseLevel(v, config.log_level);
+			} else if (key == "debug") {
+				config.debug = std::strtol(v, &end, 10) != 0;
+			} else if (key == "video") {
+				config.video = value;
+				return true;
+			} else if (key == "socket") {
+				config.socket = value;
+				return true;
+			} else if (key == "shm") {
+				config.shm = value;
+				return true;
+			} else if (key == "cheats") {
+				std::vector<sCheat> list;
+				config.cheats = value;
+				return cCheats::ParseList(value, list);
+			} else if (key == "coverage") {
+				config.coverage = value;
+				return true;
+			} else if (key == "library") {
+				config.library = value;
+				return true;
+			} else if (key == "library_cache") {
+				config.library_cache = value;
+				return !value.empty();
+			} else if (key == "net_peer") {
+				config.net_peer = value;
+				return true;
+			} else if (key == "net_port") {
+				config.net_port = std::clamp(std::strtol(v, &end, 10), 1l, 65535l);
+			} else if (key == "net_delay") {
+				config.net_delay = std::clamp(std::strtol(v, &end, 10), 0l, 8l);
+			} else if (key == "net_latency") {
+				config.net_latency = std::max(0.0f, std::strtof(v, &end));
+			} else if (key == "net_jitter") {
+				config.net_jitter = std::max(0.0f, std::strtof(v, &end));
+			} else if (key == "net_loss") {
+				config.net_loss = std::clamp(std::strtof(v, &end), 0.0f, 1.0f);
+			} else {
+				return false;
+			}
+			return *v && *end == '\0';
+		}
+
+		bool LoadFile (const char* path) {
+			std::ifstream in(path);
+			if (!in) {
+				return false;
+			}
+			file_loaded = true;
+			std::vector<sSetting>* section = &global;
+			std::string line;
+			sConfig scratch;
+			for (int number = 1; std::getline(in, line); ++number) {
+				line = Trim(line.substr(0, line.find('#')));
+				if (line.empty()) {
+					continue;
+				}
+				unsigned long long hash;
+				if (sscanf(line.c_str(), "[rom %llx]", &hash) == 1) {
+					section = &per_rom[hash];
+					continue;
+				}
+				const size_t eq = line.find('=');
+				const sSetting setting {Trim(line.substr(0, eq)), (eq == std::string::npos) ? "" : Trim(line.substr(eq + 1))};
+				if (eq == std::string::npos || !Apply(scratch, setting.key, setting.value)) {
+					nDebug::LogError(nDebug::ConvertToString(std::string(path) + ":", number, ": ignoring '") + line + "'");
+					continue;
+				}
+				section->push_back(setting);
+			}
+			return true;
+		}
+		bool FileLoaded () const {
+			return file_loaded;
+		}
+
+		// Command line after the ROM name. The historical short flags map onto
+		// config keys; any key can also be given as --key=value.
+		bool SetFromArgs (int argc, char **argv, int first) {
+			const char* const flags[][2] = {{"-k", "keys"}, {"-i", "slices"}, {"-s", "size"},
+											{"-f", "filter"}, {"-r", "video"}, {"-l", "log"}};
+			sConfig scratch;
+			for (int i = first; i < argc; ++i) {
+				sSetting setting;
+				if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+					if (!LoadFile(argv[++i])) {
+						nDebug::LogError(std::string("Unable to open config file ") + argv[i]);
+						return false;
+					}
+					continue;
+				} else if (std::strcmp(argv[i], "-d") == 0) {
+					setting = {"debug", "1"};
+				} else if (std::strncmp(argv[i], "--", 2) == 0 && std::strchr(argv[i], '=')) {
+					const std::string arg = argv[i] + 2;
+					setting = {arg.substr(0, arg.find('=')), arg.substr(arg.find('=') + 1)};
+				} else {
+					for (const auto &flag : flags) {
+						if (std::strcmp(argv[i], flag[0]) == 0 && i + 1 < argc) {
+							setting = {flag[1], argv[++i]};
+							break;
+						}
+					}
+				}
+				if (setting.key.empty() || !Apply(scratch, setting.key, setting.value)) {
+					nDebug::LogError(std::string("Bad argument ") + argv[i]);
+					return false;
+				}
+				args.push_back(setting);
+			}
+			return true;
+		}
+
+		// The file's [rom <hash>] section, or nullptr when it has none.
+		const std::vector<sSetting>* RomSettings (uint64_t rom_hash) const {
+			const auto rom = per_rom.find(rom_hash);
+			return (rom == per_rom.end()) ? nullptr : &rom->second;
+		}
+
+		sConfig Resolve (uint64_t rom_hash) const {
+			sConfig config;
+			for (const sSetting &s : global) {
+				Apply(config, s.key, s.value);
+			}
+			const auto rom = per_rom.find(rom_hash);
+			if (rom != per_rom.end()) {
+				for (const sSetting &s : rom->second) {
+					Apply(config, s.key, s.value);
+				}
+			}
+			for (const sSetting &s : args) {
+				Apply(config, s.key, s.value);
+			}
+			return config;
+		}
+};
+
+#endif
@@ -0,0 +1,188 @@
+#pragma once
+
+#ifndef CoverageCommon
+#define CoverageCommon
+
+#include <cmath>
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+#include "std_Capture.h"
+#include "std_Disasm.h"
+
+#define COVERAGE_SCALE	8
+#define COVERAGE_TOP	16
+
+// Per-address counters over the whole 4 KB: instructions executed there,
+// bytes read as data by Dxyn / Fx65, bytes written by Fx33 / Fx55. Like the
+// debugger it looks at the instruction about to run from outside the core,
+// so the main loop only pays for it on the instrumented path, taken while
+// Active() is true.
+class cCoverage {
+	private:
+		cCPU*		_cpu{};
+		sRegister*	_reg{};
+		uint8_t*	_mem{};
+		bool		active = false;
+
+		uint32_t	exec[MEM_SIZE] {};
+		uint32_t	read[MEM_SIZE] {};
+		uint32_t	write[MEM_SIZE] {};
+		// Writes that landed on an address after it had already run as code:
+		// anything caching decoded instructions there would now be stale.
+		uint32_t	stale[MEM_SIZE] {};
+
+		void Count (uint32_t* map, uint16_t addr, int len) {
+			for (int i = 0; i < len; ++i) {
+				map[(addr + i) & MEM_MASK]++;
+			}
+		}
+
+		uint16_t InstrAt (uint16_t addr) const {
+			return (_mem[addr & MEM_MASK] << 8) | _mem[(addr + 1) & MEM_MASK];
+		}
+
+		// 0-255 on a log scale against the largest count in the map.
+		static uint8_t Level (uint32_t count, uint32_t max) {
+			if (count == 0 || max == 0) {
+				return 0;
+			}
+			return 64 + 191 * std::log((double) count) / std::max(1.0, std::log((double) max));
+		}
+
+	public:
+		cCoverage () {};
+		cCoverage (cCPU &cpu, sRegister &reg, uint8_t* mem) : _cpu(&cpu), _reg(&reg), _mem(mem) {};
+
+		void SetActive (bool active) {
+			this->active = active;
+		}
+		bool Active () const {
+			return active;
+		}
+		void Clear () {
+			std::memset(exec, 0, sizeof exec);
+			std::memset(read, 0, sizeof read);
+			std::memset(write, 0, sizeof write);
+			std::memset(stale, 0, sizeof stale);
+		}
+
+		// Call right before cCPU::Run.
+		void Record () {
+			if (!active || !_cpu->GetState()) {
+				return;
+			}
+			const uint16_t pc = _reg->PC & MEM_MASK;
+			const sOpcode op(InstrAt(pc));
+			exec[pc]++;
+			switch (op.instr >> 12) {
+				case (0xD):
+					Count(read, _reg->I, op.N);
+					break;
+				case (0xF): {
+					const int len = (op.NN == 0x33) ? 3 : op.X + 1;
+					if (op.NN == 0x65) {
+						Count(read, _reg->I, len);
+					} else if (op.NN == 0x33 || op.NN == 0x55) {
+						Count(write, _reg->I, len);
+						for (int i = 0; i < len; ++i) {
+							const uint16_t addr = (_reg->I + i) & MEM_MASK;
+							stale[addr] += (exec[addr] || exec[(addr - 1) & MEM_MASK]);
+						}
+					}
+					break;
+				}
+			}
+		}
+
+		// One pixel per address, 64 addresses per row, scaled up: green for
+		// code, blue for data reads, red for writes, brighter for hotter.
+		bool WriteHeatMap (const char* path) const {
+			const uint32_t max_exec = *std::max_element(exec, exec + MEM_SIZE);
+			const uint32_t max_read = *std::max_element(read, read + MEM_SIZE);
+			const uint32_t max_write = *std::max_element(write, write + MEM_SIZE);
+			const int side = 64 * COVERAGE_SCALE;
+			std::vector<uint32_t> rgba(side * side);
+			for (int y = 0; y < side; ++y) {
+				for (int x = 0; x < side; ++x) {
+					const int addr = (y / COVERAGE_SCALE) * 64 + x / COVERAGE_SCALE;
+					rgba[y * side + x] = (Level(write[addr], max_write) << 24) | (Level(exec[addr], max_exec) << 16)
+										 | (Level(read[addr], max_read) << 8) | 0xFF;
+				}
+			}
+			return nEncode::WritePNG(path, rgba.data(), side, side);
+		}
+
+		bool WriteReport (const char* path) const {
+			FILE* f = fopen(path, "w");
+			if (!f) {
+				return false;
+			}
+			const auto bytes = [](const uint32_t* map) { return (int) std::count_if(map, map + MEM_SIZE, [](uint32_t n) { return n != 0; }); };
+			fprintf(f, "instructions at %d addresses, %d bytes read as data, %d bytes written\n",
+					bytes(exec), bytes(read), bytes(write));
+
+			fprintf(f, "\nexecuted ranges:\n");
+			for (int addr = 0; addr < MEM_SIZE; ) {
+				if (!exec[addr]) {
+					addr++;
+					continue;
+				}
+				const int start = addr;
+				while (addr < MEM_SIZE && exec[addr]) {
+					addr += 2;
+				}
+				fprintf(f, "  %03X-%03X\n", start, addr - 1);
+			}
+
+			std::vector<uint16_t> order(MEM_SIZE);
+			for (int i = 0; i < MEM_SIZE; ++i) {
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) { return exec[a] > exec[b]; });
+			fprintf(f, "\nhottest instructions:\n");
+			for (int i = 0; i < COVERAGE_TOP && exec[order[i]]; ++i) {
+				fprintf(f, "  %03X %10u  %s\n", order[i], exec[order[i]], nDisasm::Disassemble(sOpcode(InstrAt(order[i]))).c_str());
+			}
+
+			// A taken backward 1nnn closes a loop; its body runs from the target
+			// to the jump and the jump's own count is the trip count.
+			std::vector<uint16_t> loops;
+			for (int addr = 0; addr < MEM_SIZE; ++addr) {
+				const sOpcode op(InstrAt(addr));
+				if (exec[addr] && (op.instr >> 12) == 0x1 && op.NNN <= addr) {
+					loops.push_back(addr);
+				}
+			}
+			std::stable_sort(loops.begin(), loops.end(), [&](uint16_t a, uint16_t b) { return exec[a] > exec[b]; });
+			fprintf(f, "\nhot loops:\n");
+			for (size_t i = 0; i < loops.size() && i < COVERAGE_TOP; ++i) {
+				const uint16_t target = InstrAt(loops[i]) & 0xFFF;
+				uint64_t body = 0;
+				for (int addr = target; addr <= loops[i]; addr += 2) {
+					body += exec[addr];
+				}
+				fprintf(f, "  %03X-%03X %10u iterations %12llu instructions\n", target, loops[i] + 1, exec[loops[i]],
+						(unsigned long long) body);
+			}
+
+			// Code that was also written, either before it first ran (generated)
+			// or after (patched, counted in stale).
+			fprintf(f, "\nself-modifying code:\n");
+			int modified = 0;
+			for (int addr = 0; addr < MEM_SIZE; ++addr) {
+				if (write[addr] && (exec[addr] || exec[(addr - 1) & MEM_MASK])) {
+					fprintf(f, "  %03X %10u writes %10u after running\n", addr, write[addr], stale[addr]);
+					modified++;
+				}
+			}
+			if (modified == 0) {
+				fprintf(f, "  none\n");
+			}
+			fclose(f);
+			return true;
+		}
+};
+
+#endif
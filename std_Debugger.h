@@ -0,0 +1,331 @@
+#pragma once
+
+#ifndef DebuggerCommon
+#define DebuggerCommon
+
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+#include "std_Disasm.h"
+#include "std_Cheat.h"
+
+#define BITMAP_WORDS	(MEM_SIZE / 64)
+
+// Terminal debugger driven from stdin. The main loop only routes execution
+// through Step() while Active() is true, so the plain core pays nothing for
+// breakpoints that are not set.
+class cDebugger {
+	private:
+		cCPU*		_cpu{};
+		sRegister*	_reg{};
+		uint8_t*	_mem{};
+		cCheats*	_cheats{};
+
+		cRamSearch	search;
+		bool		searching = false;
+
+		uint64_t	breakpoints[BITMAP_WORDS] {};
+		uint64_t	watchpoints[BITMAP_WORDS] {};
+		int			bp_count = 0;
+		int			wp_count = 0;
+
+		bool		broken = false;
+		bool		step_over = false;
+		uint16_t	step_over_ret{};
+		int			step_over_depth{};
+
+		static bool TestBit (const uint64_t* map, uint16_t addr) {
+			return (map[addr >> 6] >> (addr & 63)) & 1;
+		}
+		static bool SetBit (uint64_t* map, uint16_t addr, bool value) {
+			const bool was = TestBit(map, addr);
+			if (value) {
+				map[addr >> 6] |= (uint64_t) 1 << (addr & 63);
+			} else {
+				map[addr >> 6] &= ~((uint64_t) 1 << (addr & 63));
+			}
+			return was;
+		}
+
+		uint16_t InstrAt (uint16_t addr) const {
+			return (_mem[addr & 0xFFF] << 8) | _mem[(addr + 1) & 0xFFF];
+		}
+
+		// Range the instruction at PC is about to store to (Fx33 / Fx55).
+		bool PendingWrite (uint16_t &addr, int &len) const {
+			const sOpcode op(InstrAt(_reg->PC));
+			if ((op.instr >> 12) != 0xF) {
+				return false;
+			}
+			if (op.NN == 0x33) {
+				len = 3;
+			} else if (op.NN == 0x55) {
+				len = op.X + 1;
+			} else {
+				return false;
+			}
+			addr = _reg->I;
+			return true;
+		}
+
+		void PrintLocation () const {
+			const uint16_t pc = _reg->PC;
+			std::cerr << std::hex << std::uppercase << std::setfill('0')
+					  << std::setw(3) << pc << ": " << std::setw(4) << InstrAt(pc) << "  "
+					  << nDisasm::Disassemble(sOpcode(InstrAt(pc))) << std::dec << "\n";
+		}
+
+		void PrintRegisters () const {
+			std::cerr << std::hex << std::uppercase << std::setfill('0');
+			std::cerr << "PC=" << std::setw(3) << _reg->PC << " I=" << std::setw(3) << _reg->I
+					  << " SP=" << _cpu->GetStackDepth() << " cycle=" << std::dec << _cpu->GetCycle() << "\n" << std::hex;
+			for (int i = 0; i < 0x10; ++i) {
+				std::cerr << "V" << i << "=" << std::setw(2) << (int) _reg->V[i] << ((i % 8 == 7) ? "\n" : " ");
+			}
+			std::cerr << std::dec;
+		}
+
+		void PrintStack () const {
+			const int depth = _cpu->GetStackDepth();
+			if (depth == 0) {
+				std::cerr << "stack empty\n";
+			}
+			for (int i = depth - 1; i >= 0; --i) {
+				std::cerr << "#" << (depth - 1 - i) << "  ret 0x" << std::hex << std::uppercase << std::setfill('0')
+						  << std::setw(3) << _cpu->stack[i] << std::dec << "\n";
+			}
+		}
+
+		void PrintDisassembly (uint16_t addr, int count) const {
+			for (int i = 0; i < count; ++i, addr += 2) {
+				const uint16_t instr = InstrAt(addr);
+				std::cerr << ((addr & 0xFFF) == _reg->PC ? "=>" : "  ")
+						  << (TestBit(breakpoints, addr & 0xFFF) ? "*" : " ")
+						  << std::hex << std::uppercase << std::setfill('0') << std::setw(3) << (addr & 0xFFF) << ": "
+						  << std::setw(4) << instr << "  " << nDisasm::Disassemble(sOpcode(instr)) << std::dec << "\n";
+			}
+		}
+
+		void PrintMemory (uint16_t addr, int len) const {
+			std::cerr << std::hex << std::uppercase << std::setfill('0');
+			for (int i = 0; i < len; ++i) {
+				if (i % 16 == 0) {
+					std::cerr << (i ? "\n" : "") << std::setw(3) << ((addr + i) & 0xFFF) << ":";
+				}
+				std::cerr << " " << std::setw(2) << (int) _mem[(addr + i) & 0xFFF];
+			}
+			std::cerr << std::dec << "\n";
+		}
+
+		void PrintHelp () const {
+			std::cerr << "c                 continue\n"
+					  << "s                 step one instruction\n"
+					  << "n                 step, running 2nnn calls to completion\n"
+					  << "b <addr>          set breakpoint      bd <addr>        delete breakpoint\n"
+					  << "w <addr> [len]    watch Fx33/Fx55     wd <addr> [len]  delete watchpoint\n"
+					  << "r                 registers           k                stack\n"
+					  << "d [addr] [count]  disassemble         x <addr> [len]   memory dump\n"
+					  << "ss                start RAM search    sl               list candidates\n"
+					  << "sf <eq|ne|gt|lt>  keep bytes equal / changed / up / down since the last filter\n"
+					  << "sf = <value>      keep bytes equal to value\n"
+					  << "f <addr> <value>  freeze byte         fd <addr>        unfreeze\n"
+					  << "fl                list freezes        p <addr> <value> poke once\n"
+					  << "q                 quit emulator\n";
+		}
+
+		void Search (const std::string &line) {
+			std::istringstream in(line);
+			std::string cmd, relation_name;
+			in >> cmd;
+			if (cmd == "ss") {
+				search.Start();
+				searching = true;
+				std::cerr << MEM_SIZE << " candidates\n";
+				return;
+			}
+			if (!searching) {
+				std::cerr << "no search running, start one with ss\n";
+				return;
+			}
+			if (cmd == "sf") {
+				eSearch relation;
+				unsigned int value = 0;
+				if (!(in >> relation_name) || !cRamSearch::ParseRelation(relation_name, relation)
+					|| (relation == SEARCH_VALUE && !(in >> std::hex >> value))) {
+					PrintHelp();
+					return;
+				}
+				std::cerr << search.Filter(relation, value) << " candidates\n";
+				return;
+			}
+			uint16_t addrs[32];
+			const int n = search.List(addrs, 32);
+			std::cerr << std::hex << std::uppercase << std::setfill('0');
+			for (int i = 0; i < n; ++i) {
+				std::cerr << std::setw(3) << addrs[i] << "=" << std::setw(2) << (int) _mem[addrs[i]] << ((i % 8 == 7 || i == n - 1) ? "\n" : "  ");
+			}
+			std::cerr << std::dec;
+			if (search.Count() > n) {
+				std::cerr << "... " << search.Count() - n << " more\n";
+			}
+		}
+
+		void Cheat (const std::string &line) {
+			std::istringstream in(line);
+			std::string cmd;
+			unsigned int addr{}, value{};
+			in >> cmd >> std::hex;
+			if (cmd == "fl") {
+				std::cerr << std::hex << std::uppercase << std::setfill('0');
+				for (int i = 0; i < _cheats->Count(); ++i) {
+					std::cerr << std::setw(3) << _cheats->Get(i).addr << "=" << std::setw(2) << (int) _cheats->Get(i).value << "\n";
+				}
+				std::cerr << std::dec;
+			} else if (cmd == "fd" && in >> addr) {
+				_cheats->Unfreeze(addr);
+			} else if (in >> addr >> value && value <= 0xFF) {
+				if (cmd == "p") {
+					_cheats->Poke(addr, value);
+				} else if (!_cheats->Freeze(addr, value)) {
+					std::cerr << "at most " << CHEAT_MAX << " freezes\n";
+				}
+			} else {
+				PrintHelp();
+			}
+		}
+
+		// Returns false when the user asked to quit the emulator.
+		bool Repl () {
+			nDebug::Flush();
+			PrintLocation();
+			std::string line;
+			while (true) {
+				std::cerr << "(chip8) " << std::flush;
+				if (!std::getline(std::cin, line)) {
+					// No terminal to talk to: drop everything and let the core run free.
+					Reset();
+					return true;
+				}
+				std::istringstream in(line);
+				std::string cmd;
+				unsigned int addr = _reg->PC, len = 1, value{};
+				in >> cmd;
+				if (in >> std::hex >> value) {
+					addr = value & 0xFFF;
+					if (in >> std::dec >> value) {
+						len = value;
+					}
+				}
+
+				if (cmd == "c" || cmd == "continue") {
+					return true;
+				} else if (cmd == "s" || cmd == "step") {
+					broken = true;
+					return true;
+				} else if (cmd == "n" || cmd == "next") {
+					if ((InstrAt(_reg->PC) >> 12) == 0x2) {
+						step_over = true;
+						step_over_ret = _reg->PC + 2;
+						step_over_depth = _cpu->GetStackDepth();
+					} else {
+						broken = true;
+					}
+					return true;
+				} else if (cmd == "b") {
+					bp_count += !SetBit(breakpoints, addr, true);
+				} else if (cmd == "bd") {
+					bp_count -= SetBit(breakpoints, addr, false);
+				} else if (cmd == "w" || cmd == "wd") {
+					for (unsigned int i = 0; i < len; ++i) {
+						if (cmd == "w") {
+							wp_count += !SetBit(watchpoints, (addr + i) & 0xFFF, true);
+						} else {
+							wp_count -= SetBit(watchpoints, (addr + i) & 0xFFF, false);
+						}
+					}
+				} else if (cmd == "r" || cmd == "regs") {
+					PrintRegisters();
+				} else if (cmd == "k" || cmd == "stack") {
+					PrintStack();
+				} else if (cmd == "d" || cmd == "dis") {
+					PrintDisassembly(addr, len > 1 ? len : 10);
+				} else if (cmd == "x") {
+					PrintMemory(addr, len > 1 ? len : 16);
+				} else if (cmd == "ss" || cmd == "sf" || cmd == "sl") {
+					Search(line);
+				} else if ((cmd == "f" || cmd == "fd" || cmd == "fl" || cmd == "p") && _cheats) {
+					Cheat(line);
+				} else if (cmd == "q" || cmd == "quit") {
+					return false;
+				} else if (!cmd.empty()) {
+					PrintHelp();
+				}
+			}
+		}
+
+	public:
+		cDebugger () {};
+		cDebugger (cCPU &cpu, sRegister &reg, uint8_t* mem, cCheats* cheats = nullptr) : _cpu(&cpu), _reg(&reg), _mem(mem), _cheats(cheats), search(mem) {};
+
+		bool Active () const {
+			return bp_count || wp_count || broken || step_over;
+		}
+
+		void Break () {
+			broken = true;
+		}
+
+		void Reset () {
+			std::memset(breakpoints, 0, sizeof breakpoints);
+			std::memset(watchpoints, 0, sizeof watchpoints);
+			bp_count = wp_count = 0;
+			broken = step_over = false;
+		}
+
+		// Debug-enabled variant of cCPU::Run. Returns false when the user quits.
+		bool Step () {
+			if (!_cpu->GetState()) {
+				return true;
+			}
+
+			const uint16_t pc = _reg->PC;
+			const bool returned = step_over && pc == step_over_ret && _cpu->GetStackDepth() <= step_over_depth;
+			if (broken || returned || (bp_count && TestBit(breakpoints, pc & 0xFFF))) {
+				broken = step_over = false;
+				if (!Repl()) {
+					return false;
+				}
+			}
+
+			uint16_t watch_addr{};
+			int watch_len{};
+			uint8_t before[0x10];
+			bool watched = false;
+			if (wp_count && PendingWrite(watch_addr, watch_len)) {
+				for (int i = 0; i < watch_len; ++i) {
+					before[i] = _mem[(watch_addr + i) & 0xFFF];
+					watched |= TestBit(watchpoints, (watch_addr + i) & 0xFFF);
+				}
+			}
+
+			_cpu->Run();
+			if (_cheats && _cheats->Active()) {
+				_cheats->Apply();
+			}
+
+			if (watched) {
+				std::cerr << "watchpoint: write by 0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(3) << pc << "\n";
+				for (int i = 0; i < watch_len; ++i) {
+					const uint16_t addr = (watch_addr + i) & 0xFFF;
+					if (TestBit(watchpoints, addr)) {
+						std::cerr << "  [" << std::setw(3) << addr << "] " << std::setw(2) << (int) before[i]
+								  << " -> " << std::setw(2) << (int) _mem[addr] << "\n";
+					}
+				}
+				std::cerr << std::dec;
+				broken = true;
+			}
+			return true;
+		}
+};
+
+#endif
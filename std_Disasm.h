@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef DisasmCommon
+#define DisasmCommon
+
+#include "std_CommonIncludes.h"
+#include "std_Opcode.h"
+
+namespace nDisasm
+{
+	// Mnemonics follow the instructions cCPU::Execute actually implements;
+	// anything it treats as a no-op is shown as raw data.
+	inline std::string Disassemble (const sOpcode &op) {
+		char buf[32];
+		const int x = op.X, y = op.Y, nn = op.NN, n = op.N, nnn = op.NNN;
+
+		switch (op.instr >> 12) {
+			case (0x0):
+				if (nnn == 0x0E0)	return "CLS";
+				if (nnn == 0x0EE)	return "RET";
+				break;
+			case (0x1):	snprintf(buf, sizeof buf, "JP   0x%03X", nnn);			return buf;
+			case (0x2):	snprintf(buf, sizeof buf, "CALL 0x%03X", nnn);			return buf;
+			case (0x3):	snprintf(buf, sizeof buf, "SE   V%X, 0x%02X", x, nn);	return buf;
+			case (0x4):	snprintf(buf, sizeof buf, "SNE  V%X, 0x%02X", x, nn);	return buf;
+			case (0x5):	snprintf(buf, sizeof buf, "SE   V%X, V%X", x, y);		return buf;
+			case (0x6):	snprintf(buf, sizeof buf, "LD   V%X, 0x%02X", x, nn);	return buf;
+			case (0x7):	snprintf(buf, sizeof buf, "ADD  V%X, 0x%02X", x, nn);	return buf;
+			case (0x8): {
+				static const char* const ops[16] = {"LD  ", "OR  ", "AND ", "XOR ", "ADD ", "SUB ", "SHR ", "SUBN",
+													nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL ", nullptr};
+				if (ops[n] == nullptr)	break;
+				snprintf(buf, sizeof buf, "%s V%X, V%X", ops[n], x, y);
+				return buf;
+			}
+			case (0x9):	snprintf(buf, sizeof buf, "SNE  V%X, V%X", x, y);		return buf;
+			case (0xA):	snprintf(buf, sizeof buf, "LD   I, 0x%03X", nnn);		return buf;
+			case (0xB):	snprintf(buf, sizeof buf, "JP   V0, 0x%03X", nnn);		return buf;
+			case (0xC):	snprintf(buf, sizeof buf, "RND  V%X, 0x%02X", x, nn);	return buf;
+			case (0xD):	snprintf(buf, sizeof buf, "DRW  V%X, V%X, %d", x, y, n);	return buf;
+			case (0xE):
+				if (nn == 0x9E)	{ snprintf(buf, sizeof buf, "SKP  V%X", x);		return buf; }
+				if (nn == 0xA1)	{ snprintf(buf, sizeof buf, "SKNP V%X", x);		return buf; }
+				break;
+			case (0xF):
+				switch (nn) {
+					case (0x07):	snprintf(buf, sizeof buf, "LD   V%X, DT", x);	return buf;
+					case (0x0A):	snprintf(buf, sizeof buf, "LD   V%X, K", x);	return buf;
+					case (0x15):	snprintf(buf, sizeof buf, "LD   DT, V%X", x);	return buf;
+					case (0x18):	snprintf(buf, sizeof buf, "LD   ST, V%X", x);	return buf;
+					case (0x1E):	snprintf(buf, sizeof buf, "ADD  I, V%X", x);	return buf;
+					case (0x29):	snprintf(buf, sizeof buf, "LD   F, V%X", x);	return buf;
+					case (0x33):	snprintf(buf, sizeof buf, "LD   B, V%X", x);	return buf;
+					case (0x55):	snprintf(buf, sizeof buf, "LD   [I], V%X", x);	return buf;
+					case (0x65):	snprintf(buf, sizeof buf, "LD   V%X, [I]", x);	return buf;
+				}
+				break;
+		}
+
+		snprintf(buf, sizeof buf, "DW   0x%04X", op.instr);
+		return buf;
+	}
+}
+
+#endif
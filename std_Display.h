@@ -6,6 +6,7 @@
 #include <SDL2/SDL.h>
 #include "std_Chip8Includes.h"
 #include "std_CommonIncludes.h"
+#include "std_Scaler.h"
 
 struct sSDL {
     SDL_Window* dispWindow = nullptr;
@@ -16,77 +17,155 @@ class cSDL {
     private:
         SDL_Window* _window;
         SDL_Renderer* _renderer;
-        SDL_Rect rect;
-        const uint32_t fg_col = FG_COLOR;
-        const uint32_t bg_col = BG_COLOR;
+        SDL_Texture* _texture = nullptr;
+        SDL_Texture* _overlay = nullptr;
+        int overlay_width = 0;
+        int overlay_height = 0;
+        SDL_Rect dst;
+        uint32_t fg_col = FG_COLOR;
+        uint32_t bg_col = BG_COLOR;
+        float lerp_rate = LERP_RATE;
+        eFilter filter = OUTLINES ? FILTER_OUTLINE : FILTER_NEAREST;
+        int win_width = DISP_WIDTH * DISP_FACTOR;
+        int win_height = DISP_HEIGHT * DISP_FACTOR;
+        cScaler scaler;
+        std::vector<uint32_t> pixels;
+        std::string title = "CHIP-8 Emulator";
+        // Scaler, streaming texture and destination rectangle for the
+        // current window size.
+        void Layout () {
+            scaler.Configure(win_width, win_height, filter, fg_col, bg_col);
+            pixels.assign(scaler.Width() * scaler.Height(), bg_col);
+            SDL_DestroyTexture(_texture);
+            _texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+                                         scaler.Width(), scaler.Height());
+            if (_texture == nullptr) {
+                nDebug::LogError("Texture could not be created! SDL_Error");
+            }
+            dst = {.x = (win_width - scaler.Width()) / 2, .y = (win_height - scaler.Height()) / 2,
+                   .w = scaler.Width(), .h = scaler.Height()};
+        }
     public:
         cSDL () {};
         cSDL (SDL_Window* window, SDL_Renderer* renderer) : _window(window), _renderer(renderer) {};
 
-        void InitSDL () {
+        void InitSDL (int width = DISP_WIDTH * DISP_FACTOR, int height = DISP_HEIGHT * DISP_FACTOR) {
+            win_width = width;
+            win_height = height;
             if (SDL_Init(SDL_INIT_VIDEO) < 0) {
                     nDebug::LogError("SDL could not initialize! SDL_Error");
             } else {
-                _window = SDL_CreateWindow("CHIP-8 Emulator",SDL_WINDOWPOS_CENTERED,
+                _window = SDL_CreateWindow(title.c_str(),SDL_WINDOWPOS_CENTERED,
                                     SDL_WINDOWPOS_CENTERED,
-                                    DISP_WIDTH * DISP_FACTOR,
-                                    DISP_HEIGHT * DISP_FACTOR,
+                                    width,
+                                    height,
                                     0);
                 if (_window == nullptr) {
                     nDebug::LogError("Window could not be created! SDL_Error");
                     SDL_Quit();
                 }
                 _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED);
+                if (_renderer == nullptr) {
+                    _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_SOFTWARE);
+                }
                 if (_renderer == nullptr) {
                     nDebug::LogError("Renderer could not be created! SDL_Error");
                     SDL_DestroyWindow(_window);
                     SDL_Quit();
                 }
             }
-            rect = {.x = 0, .y = 0, .w = DISP_FACTOR, .h = DISP_FACTOR};
+
+            Layout();
         }
 
-        void UpdateFrame (uint8_t* disp, uint32_t* color) {
-            SDL_SetRenderDrawColor(_renderer, 0x00, 0x00, 0x00, 0xFF);
-            SDL_RenderClear(_renderer);
+        // Window size from the config. Before InitSDL this only records it;
+        // afterwards the window is resized and the display laid out again,
+        // so a [rom] section's size takes effect on a ROM switch.
+        void SetSize (int width, int height) {
+            if (width == win_width && height == win_height) {
+                return;
+            }
+            win_width = width;
+            win_height = height;
+            if (_texture) {
+                SDL_SetWindowSize(_window, width, height);
+                Layout();
+            }
+        }
 
-            for (uint32_t i = 0; i < DISP_WIDTH * DISP_HEIGHT; i++) {
-                rect.x = (i % DISP_WIDTH) * DISP_FACTOR;
-                rect.y = (i / DISP_WIDTH) * DISP_FACTOR;
+        // Filter, colours and fade speed. Before InitSDL this only records them;
+        // afterwards the scaler tiles are rebuilt for the existing window.
+        void SetLook (eFilter filter, uint32_t fg, uint32_t bg, float lerp) {
+            const bool changed = filter != this->filter || fg != fg_col || bg != bg_col;
+            this->filter = filter;
+            fg_col = fg;
+            bg_col = bg;
+            lerp_rate = lerp;
+            if (_texture && changed) {
+                scaler.Configure(win_width, win_height, filter, fg_col, bg_col);
+            }
+        }
+
+        // Safe to call before InitSDL; the window picks the title up when it is created.
+        void SetTitle (const std::string &title) {
+            this->title = title;
+            if (_window) {
+                SDL_SetWindowTitle(_window, title.c_str());
+            }
+        }
 
+        void UpdateFrame (const uint8_t* disp, uint32_t* color) {
+            for (uint32_t i = 0; i < DISP_WIDTH * DISP_HEIGHT; i++) {
                 if (disp[i] == 0x1) {
-                    if (color[i] != FG_COLOR) {
+                    if (color[i] != fg_col) {
                         color[i] = ColorLerp(fg_col, color[i]);
                     }
-                    SDL_SetRenderDrawColor(_renderer, (fg_col >> 24) & 0xFF, (fg_col >> 16) & 0xFF, (fg_col >> 8) & 0xFF, (fg_col) & 0xFF);
-                    SDL_RenderFillRect(_renderer, &rect);
-                    if (OUTLINES) {
-                        SDL_SetRenderDrawColor(_renderer, (bg_col >> 24) & 0xFF, (bg_col >> 16) & 0xFF, (bg_col >> 8) & 0xFF, (bg_col) & 0xFF);
-                        SDL_RenderDrawRect(_renderer, &rect);
-                    }
                 } else {
-                    if (color[i] != BG_COLOR) {
+                    if (color[i] != bg_col) {
                         color[i] = ColorLerp(bg_col, color[i]);
                     }
-                    SDL_SetRenderDrawColor(_renderer, (bg_col >> 24) & 0xFF, (bg_col >> 16) & 0xFF, (bg_col >> 8) & 0xFF, (bg_col) & 0xFF);
-                    SDL_RenderFillRect(_renderer, &rect);
                 }
             }
 
+            scaler.Render(disp, pixels.data());
+            SDL_UpdateTexture(_texture, nullptr, pixels.data(), scaler.Width() * sizeof(uint32_t));
+
+            SDL_SetRenderDrawColor(_renderer, 0x00, 0x00, 0x00, 0xFF);
+            SDL_RenderClear(_renderer);
+            SDL_RenderCopy(_renderer, _texture, nullptr, &dst);
+            SDL_RenderPresent(_renderer);
+        }
+
+        // Presents an RGBA image in place of the CHIP-8 display, scaled into
+        // the same rectangle. Used by the ROM picker.
+        void UpdateOverlay (const uint32_t* rgba, int width, int height) {
+            if (!_overlay || width != overlay_width || height != overlay_height) {
+                SDL_DestroyTexture(_overlay);
+                _overlay = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+                overlay_width = width;
+                overlay_height = height;
+            }
+            SDL_UpdateTexture(_overlay, nullptr, rgba, width * sizeof(uint32_t));
+
+            SDL_SetRenderDrawColor(_renderer, 0x00, 0x00, 0x00, 0xFF);
+            SDL_RenderClear(_renderer);
+            SDL_RenderCopy(_renderer, _overlay, nullptr, &dst);
             SDL_RenderPresent(_renderer);
         }
 
         void QuitSDL () {
+            SDL_DestroyTexture(_overlay);
+            SDL_DestroyTexture(_texture);
             SDL_DestroyRenderer(_renderer);
             SDL_DestroyWindow(_window);
             SDL_Quit();
         }
         
         uint32_t ColorLerp(const uint32_t start, const uint32_t end) {
-            const uint8_t r = (start >> 24) + LERP_RATE * ((end >> 24) - (start >> 24));
-            const uint8_t g = (start >> 16) + LERP_RATE * ((end >> 16) - (start >> 16));
-            const uint8_t b = (start >> 8) + LERP_RATE * ((end >> 8) - (start >> 8));
-            const uint8_t a = (start) + LERP_RATE * ((end) - (start));
+            const uint8_t r = (start >> 24) + lerp_rate * ((end >> 24) - (start >> 24));
+            const uint8_t g = (start >> 16) + lerp_rate * ((end >> 16) - (start >> 16));
+            const uint8_t b = (start >> 8) + lerp_rate * ((end >> 8) - (start >> 8));
+            const uint8_t a = (start) + lerp_rate * ((end) - (start));
 
             return (r << 24) | (g << 16) | (b << 8) | a;
         }
@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef EnvCommon
+#define EnvCommon
+
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+#include "std_Fusion.h"
+#include "chip8env.h"
+
+// sEnvView and tRewardHook are declared in the C header so the same hook
+// type works through env.cc.
+static_assert(CHIP8_ENV_WIDTH == DISP_WIDTH && CHIP8_ENV_HEIGHT == DISP_HEIGHT);
+
+// Headless, SDL-free machine for agents. Everything lives inside the object,
+// so once a ROM is loaded reset and step never allocate.
+//
+// An action is the set of keys held during the step, bit n for key n. Keys
+// that change are fed through cCPU::SetKey exactly like host key events, so
+// a tap shorter than a frame still registers.
+class cEnv {
+	private:
+		sRegister	reg;
+		uint8_t		memory[MEM_SIZE] {};
+		uint8_t		frame_buffer[DISP_WIDTH * DISP_HEIGHT] {};
+		uint8_t		delay_timer{};
+		uint8_t		sound_timer{};
+		cCPU		cpu;
+		cFusion		fusion;
+		bool		fused = false;
+
+		uint16_t	held = 0;
+		int			budget = INST_PER_SEC / 60;
+		tRewardHook	reward{};
+		void*		reward_user{};
+
+	public:
+		cEnv () : cpu(reg, memory, delay_timer, sound_timer, frame_buffer), fusion(cpu) {};
+		// cpu and fusion point into this object, so it cannot be copied or
+		// moved; handles from the C interface stay valid for its lifetime.
+		cEnv (const cEnv&) = delete;
+		cEnv& operator= (const cEnv&) = delete;
+		cEnv (cEnv&&) = delete;
+		cEnv& operator= (cEnv&&) = delete;
+
+		void Load (const uint8_t* image, size_t size) {
+			cpu.Boot(image, size);
+			held = 0;
+		}
+
+		// Instructions per emulated frame; the default matches the emulator.
+		void SetBudget (int instructions) {
+			budget = std::max(1, instructions);
+			cpu.SetTimerPeriod(budget);
+		}
+		// Runs frames through cFusion; same results, faster on idle loops.
+		void SetFusion (bool on) {
+			fused = on;
+		}
+		void SetReward (tRewardHook hook, void* user) {
+			reward = hook;
+			reward_user = user;
+		}
+
+		void Reset (uint32_t seed) {
+			cpu.Reset();
+			cpu.Seed(seed);
+			held = 0;
+		}
+
+		// Holds action for frames emulated frames and returns the hook's reward
+		// (0 without one).
+		float Step (uint16_t action, int frames = 1) {
+			for (uint16_t changed = action ^ held; changed; changed &= changed - 1) {
+				const int key = __builtin_ctz(changed);
+				cpu.SetKey(key, (action >> key) & 1);
+			}
+			held = action;
+			for (int f = 0; f < frames; ++f) {
+				if (fused) {
+					fusion.RunFrame(budget);
+				} else {
+					cpu.RunFrame(budget);
+				}
+			}
+			if (!reward) {
+				return 0;
+			}
+			const sEnvView view = View();
+			return reward(&view, reward_user);
+		}
+
+		// A core that faulted or was stopped makes no further progress.
+		bool Done () {
+			return !cpu.GetState();
+		}
+
+		sEnvView View () {
+			return {memory, frame_buffer, reg.V, reg.PC, reg.I, cpu.DelayTimer(), cpu.SoundTimer(), Done()};
+		}
+		const uint8_t* Observation () const {
+			return frame_buffer;
+		}
+
+		// Steps n environments with one action each. rewards and dones are n
+		// long; observations, when given, receives n consecutive frames.
+		static void StepBatch (cEnv* const* envs, int n, const uint16_t* actions, int frames,
+							   float* rewards, uint8_t* dones, uint8_t* observations) {
+			for (int i = 0; i < n; ++i) {
+				rewards[i] = envs[i]->Step(actions[i], frames);
+				dones[i] = envs[i]->Done();
+				if (observations) {
+					std::memcpy(&observations[i * DISP_WIDTH * DISP_HEIGHT], envs[i]->frame_buffer, DISP_WIDTH * DISP_HEIGHT);
+				}
+			}
+		}
+};
+
+#endif
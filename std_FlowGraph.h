@@ -0,0 +1,215 @@
+#pragma once
+
+#ifndef FlowGraphCommon
+#define FlowGraphCommon
+
+#include <vector>
+#include <algorithm>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Opcode.h"
+
+// Per-address facts produced by cFlowAnalyzer.
+enum eFlowFlags : uint8_t {
+	FLOW_INSTR		= 0x01,	// first byte of a reachable instruction
+	FLOW_CODE		= 0x02,	// any byte of a reachable instruction
+	FLOW_LEADER		= 0x04,	// first instruction of a basic block
+	FLOW_JUMP		= 0x08,	// target of 1nnn or a skip
+	FLOW_CALL		= 0x10,	// target of 2nnn
+	FLOW_WRITTEN	= 0x20,	// statically known Fx33/Fx55 destination
+};
+
+struct sBlock {
+	uint16_t	start{};
+	uint16_t	end{};			// one past the last instruction byte
+	uint16_t	succ[2] {};
+	uint8_t		succ_count{};
+	bool		returns = false;	// ends in 00EE
+	bool		calls = false;		// ends in 2nnn; succ[0] is the callee, succ[1] the return site
+};
+
+// Recursive-descent control-flow discovery over a loaded memory image. It
+// follows the control transfers cCPU::Execute implements (1nnn, 2nnn, 00EE
+// and the conditional skips) from the entry point, so bytes it never reaches
+// are data as far as the core is concerned. Bnnn's target depends on a
+// register, so it ends a block with no successors. Stores through I are tracked
+// when I was set by an Annn earlier in the same block; a store with an
+// unknown I makes the whole image potentially self-modifying.
+class cFlowAnalyzer {
+	private:
+		const uint8_t*	_mem{};
+		uint16_t		lo{};
+		uint16_t		hi{};
+
+		bool InRange (uint16_t addr) const {
+			return addr >= lo && addr + 1 < hi;
+		}
+
+		uint16_t InstrAt (uint16_t addr) const {
+			return (_mem[addr] << 8) | _mem[addr + 1];
+		}
+
+		// 5xyN and 9xyN skip for every N in cCPU::Execute, so they do here too.
+		static bool IsSkip (const sOpcode &op) {
+			switch (op.instr >> 12) {
+				case (0x3): case (0x4):
+				case (0x5): case (0x9):	return true;
+				case (0xE):				return op.NN == 0x9E || op.NN == 0xA1;
+			}
+			return false;
+		}
+
+		void Discover (uint16_t entry) {
+			std::vector<uint16_t> work {entry};
+			flags[entry] |= FLOW_LEADER;
+
+			while (!work.empty()) {
+				uint16_t addr = work.back();
+				work.pop_back();
+
+				while (InRange(addr) && !(flags[addr] & FLOW_INSTR)) {
+					const sOpcode op(InstrAt(addr));
+					flags[addr] |= FLOW_INSTR | FLOW_CODE;
+					flags[addr + 1] |= FLOW_CODE;
+
+					if (op.instr == 0x00EE || (op.instr >> 12) == 0xB) {
+						break;
+					}
+					if ((op.instr >> 12) == 0x1) {
+						Target(op.NNN, FLOW_JUMP, work);
+						break;
+					}
+					if ((op.instr >> 12) == 0x2) {
+						Target(op.NNN, FLOW_CALL, work);
+						Target(addr + 2, 0, work);
+						break;
+					}
+					if (IsSkip(op)) {
+						Target(addr + 2, FLOW_JUMP, work);
+						Target(addr + 4, FLOW_JUMP, work);
+						break;
+					}
+					addr += 2;
+				}
+			}
+		}
+
+		void Target (uint16_t addr, uint8_t kind, std::vector<uint16_t> &work) {
+			addr &= 0xFFF;
+			flags[addr] |= FLOW_LEADER | kind;
+			if (InRange(addr)) {
+				work.push_back(addr);
+			} else {
+				external_targets++;
+			}
+		}
+
+		void BuildBlocks () {
+			for (uint32_t addr = lo; addr < hi; ++addr) {
+				if ((flags[addr] & (FLOW_LEADER | FLOW_INSTR)) != (FLOW_LEADER | FLOW_INSTR)) {
+					continue;
+				}
+
+				sBlock blk;
+				blk.start = addr;
+				uint16_t pc = addr;
+				int known_I = -1;
+				while (true) {
+					const sOpcode op(InstrAt(pc));
+					const uint16_t next = pc + 2;
+					bool ends = true;
+
+					if (op.instr == 0x00EE) {
+						blk.returns = true;
+					} else if ((op.instr >> 12) == 0xB) {
+						// Indirect; whatever it reaches runs through the interpreter.
+					} else if ((op.instr >> 12) == 0x1) {
+						blk.succ[blk.succ_count++] = op.NNN;
+					} else if ((op.instr >> 12) == 0x2) {
+						blk.calls = true;
+						blk.succ[blk.succ_count++] = op.NNN;
+						blk.succ[blk.succ_count++] = next;
+					} else if (IsSkip(op)) {
+						blk.succ[blk.succ_count++] = next;
+						blk.succ[blk.succ_count++] = next + 2;
+					} else {
+						ends = false;
+						TrackStore(op, known_I);
+					}
+
+					if (ends) {
+						blk.end = next;
+						break;
+					}
+					if (!InRange(next) || !(flags[next] & FLOW_INSTR) || (flags[next] & FLOW_LEADER)) {
+						blk.end = next;
+						if (InRange(next) && (flags[next] & FLOW_INSTR)) {
+							blk.succ[blk.succ_count++] = next;
+						}
+						break;
+					}
+					pc = next;
+				}
+				blocks.push_back(blk);
+			}
+		}
+
+		void TrackStore (const sOpcode &op, int &known_I) {
+			switch (op.instr >> 12) {
+				case (0xA):
+					known_I = op.NNN;
+					return;
+				case (0xF):
+					if (op.NN == 0x33 || op.NN == 0x55) {
+						const int len = (op.NN == 0x33) ? 3 : op.X + 1;
+						if (known_I < 0) {
+							unknown_stores++;
+						} else {
+							for (int i = 0; i < len; ++i) {
+								flags[(known_I + i) & 0xFFF] |= FLOW_WRITTEN;
+							}
+						}
+					} else if (op.NN == 0x1E || op.NN == 0x29) {
+						known_I = -1;
+					}
+					return;
+			}
+		}
+
+	public:
+		uint8_t				flags[MEM_SIZE] {};
+		std::vector<sBlock>	blocks;
+		int					external_targets = 0;
+		int					unknown_stores = 0;
+
+		cFlowAnalyzer () {};
+
+		// Analyzes mem[begin, end) starting at entry.
+		void Analyze (const uint8_t* mem, uint16_t begin, uint16_t end, uint16_t entry = ROM_ENTRYPOINT) {
+			_mem = mem;
+			lo = begin;
+			hi = std::min<uint16_t>(end, MEM_SIZE);
+			std::memset(flags, 0, sizeof flags);
+			blocks.clear();
+			external_targets = unknown_stores = 0;
+
+			Discover(entry);
+			BuildBlocks();
+		}
+
+		bool IsCode (uint16_t addr) const {
+			return flags[addr & 0xFFF] & FLOW_CODE;
+		}
+		bool IsBlockStart (uint16_t addr) const {
+			return (flags[addr & 0xFFF] & (FLOW_LEADER | FLOW_INSTR)) == (FLOW_LEADER | FLOW_INSTR);
+		}
+		// Code bytes that a statically resolved store may overwrite.
+		bool IsSelfModified (uint16_t addr) const {
+			return (flags[addr & 0xFFF] & (FLOW_CODE | FLOW_WRITTEN)) == (FLOW_CODE | FLOW_WRITTEN);
+		}
+		int CodeBytes () const {
+			return std::count_if(flags, flags + MEM_SIZE, [](uint8_t f) { return f & FLOW_CODE; });
+		}
+};
+
+#endif
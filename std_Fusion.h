@@ -0,0 +1,302 @@
+#pragma once
+
+#ifndef FusionCommon
+#define FusionCommon
+
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+// What the table holds for an address. FUSE_UNKNOWN is a slot not decoded
+// yet, FUSE_NONE one that starts no sequence, FUSE_STORE a lone Fx33 / Fx55
+// that has to drop the slots it writes over. The rest run as one handler.
+enum eFuse : uint8_t {
+	FUSE_UNKNOWN,
+	FUSE_NONE,
+	FUSE_STORE,
+	FUSE_FONT_DRAW,		// 6xnn; Fx29; Dxyn
+	FUSE_BCD_LOAD,		// Fx33; Fy65
+	FUSE_COUNT_LOOP,	// 7xnn; 3xkk / 4xkk; 1nnn
+	FUSE_SKIP_JUMP,		// any skip; 1nnn
+	FUSE_SPIN,			// 1nnn to itself
+	FUSE_WAIT_KEY,		// Fx0A
+	FUSE_WAIT_DELAY,	// Fx07; 3xkk / 4xkk; 1nnn back to the Fx07
+	FUSE_KINDS,
+};
+
+// Macro-op fusion in front of cCPU::Run. Each address is decoded once into
+// the table, on first use, as the sequence that starts there; sequences are
+// keyed on their first address, so a jump into the middle of one simply runs
+// the plain core from there. Stores the core makes drop the slots whose
+// instructions they overwrite, and a Boot or LoadState empties the table, so
+// self-modifying code stays correct. Memory written from outside the core
+// (cheats, the debugger) needs a Flush.
+//
+// A fused handler counts every instruction it covers in cycle, and is only
+// taken when the whole sequence fits in what is left of the budget. The
+// three idle kinds stand for however many passes of their loop fit: nothing
+// a spin, a key wait or a delay-timer poll looks at can change before the
+// budget ends, except the timer, and that only on a tick. Fusion counts
+// instructions, so it assumes TIMING_FLAT.
+class cFusion {
+	private:
+		cCPU*		_cpu{};
+		sRegister*	_reg{};
+		uint8_t*	_mem{};
+
+		uint8_t		table[MEM_SIZE] {};
+		uint32_t	generation = 0;
+		long int	hits[FUSE_KINDS] {};
+		long int	covered[FUSE_KINDS] {};
+
+		uint16_t Word (uint16_t pc, int k) const {
+			return (_mem[(pc + 2 * k) & MEM_MASK] << 8) | _mem[(pc + 2 * k + 1) & MEM_MASK];
+		}
+
+		static bool IsSkip (const sOpcode &op) {
+			switch (op.instr >> 12) {
+				case (0x3): case (0x4): case (0x5): case (0x9):
+					return true;
+				case (0xE):
+					return op.NN == 0x9E || op.NN == 0xA1;
+			}
+			return false;
+		}
+		// The skip condition as cCPU::Execute evaluates it; 5xyN / 9xyN skip
+		// for every N there, so they do here too.
+		bool Skips (const sOpcode &op) const {
+			switch (op.instr >> 12) {
+				case (0x3): return _reg->V[op.X] == op.NN;
+				case (0x4): return _reg->V[op.X] != op.NN;
+				case (0x5): return _reg->V[op.X] == _reg->V[op.Y];
+				case (0x9): return _reg->V[op.X] != _reg->V[op.Y];
+			}
+			return _cpu->keypad[_reg->V[op.X] & 0x0F] == (op.NN == 0x9E);
+		}
+
+		eFuse Match (uint16_t pc) const {
+			const sOpcode a(Word(pc, 0)), b(Word(pc, 1)), c(Word(pc, 2));
+			if ((a.instr >> 12) == 0x1 && a.NNN == pc) {
+				return FUSE_SPIN;
+			}
+			if ((a.instr & 0xF0FF) == 0xF00A) {
+				return FUSE_WAIT_KEY;
+			}
+			if ((a.instr & 0xF0FF) == 0xF007 && ((b.instr >> 12) == 0x3 || (b.instr >> 12) == 0x4) && b.X == a.X
+				&& (c.instr >> 12) == 0x1 && c.NNN == pc) {
+				return FUSE_WAIT_DELAY;
+			}
+			if ((a.instr >> 12) == 0x6 && b.instr == (0xF029 | a.X << 8) && (c.instr >> 12) == 0xD) {
+				return FUSE_FONT_DRAW;
+			}
+			if ((a.instr & 0xF0FF) == 0xF033 && (b.instr & 0xF0FF) == 0xF065) {
+				return FUSE_BCD_LOAD;
+			}
+			if ((a.instr >> 12) == 0x7 && ((b.instr >> 12) == 0x3 || (b.instr >> 12) == 0x4) && b.X == a.X
+				&& (c.instr >> 12) == 0x1) {
+				return FUSE_COUNT_LOOP;
+			}
+			if (IsSkip(a) && (b.instr >> 12) == 0x1) {
+				return FUSE_SKIP_JUMP;
+			}
+			if ((a.instr & 0xF0FF) == 0xF033 || (a.instr & 0xF0FF) == 0xF055) {
+				return FUSE_STORE;
+			}
+			return FUSE_NONE;
+		}
+
+		// Every slot whose three words take in one of the len bytes at addr.
+		void Invalidate (uint16_t addr, int len) {
+			for (int i = -5; i < len; ++i) {
+				table[(addr + i) & MEM_MASK] = FUSE_UNKNOWN;
+			}
+		}
+
+		// Runs the sequence at pc, in at most left instructions, and returns
+		// how many instructions that was, or 0 when it has to go through the
+		// plain core instead.
+		int Execute (eFuse kind, uint16_t pc, int left) {
+			const sOpcode a(Word(pc, 0)), b(Word(pc, 1)), c(Word(pc, 2));
+			switch (kind) {
+				case (FUSE_FONT_DRAW):
+					_reg->V[a.X] = a.NN;
+					_reg->I = _reg->V[a.X] * 5 + 0x50;
+					_reg->PC += 6;
+					_cpu->Draw(c.X, c.Y, c.N);
+					return 3;
+				case (FUSE_BCD_LOAD): {
+					// Digits landing on the Fy65 itself would change what runs next.
+					const uint16_t next = (pc + 2) & MEM_MASK;
+					for (int i = 0; i < 3; ++i) {
+						const uint16_t addr = (_reg->I + i) & MEM_MASK;
+						if (addr == next || addr == ((next + 1) & MEM_MASK)) {
+							return 0;
+						}
+					}
+					Invalidate(_reg->I, 3);
+					const uint8_t value = _reg->V[a.X];
+					_mem[_reg->I & MEM_MASK] = value / 100;
+					_mem[(_reg->I + 1) & MEM_MASK] = (value / 10) % 10;
+					_mem[(_reg->I + 2) & MEM_MASK] = value % 10;
+					for (int i = 0; i <= b.X; ++i) {
+						_reg->V[i] = _mem[(_reg->I + i) & MEM_MASK];
+					}
+					if (_cpu->quirks & QUIRK_MEMORY_I) {
+						_reg->I += b.X + 1;
+					}
+					_reg->PC += 4;
+					return 2;
+				}
+				case (FUSE_COUNT_LOOP):
+					_reg->V[a.X] += a.NN;
+					if (Skips(b)) {
+						_reg->PC += 6;
+						return 2;
+					}
+					_reg->PC = c.NNN;
+					return 3;
+				case (FUSE_SKIP_JUMP):
+					if (Skips(a)) {
+						_reg->PC += 4;
+						return 1;
+					}
+					_reg->PC = b.NNN;
+					return 2;
+				case (FUSE_SPIN):
+					_reg->PC = a.NNN;
+					return left;
+				case (FUSE_WAIT_KEY):
+					for (int i = 0; i < 16; ++i) {
+						if (_cpu->keypad[i]) {
+							return 0;
+						}
+					}
+					_cpu->key_pressed = false;
+					return left;
+				case (FUSE_WAIT_DELAY): {
+					// Every pass up to the next tick reads the same value, so
+					// they go in one step; the pass that reads the value taking
+					// the skip leaves the loop after its first two instructions.
+					const bool skip_equal = (b.instr >> 12) == 0x3;
+					const long int period = _cpu->timer_period;
+					int n = 0;
+					while (left - n >= 3) {
+						_cpu->cycle += n;
+						const uint8_t delay = _cpu->DelayTimer();
+						const long int next_tick = (_cpu->cycle / period + 1) * period;
+						const long int passes = (next_tick - _cpu->cycle + 2) / 3;
+						_cpu->cycle -= n;
+						_reg->V[a.X] = delay;
+						if ((delay == b.NN) == skip_equal) {
+							_reg->PC += 6;
+							return n + 2;
+						}
+						n += 3 * std::min<long int>(passes, (left - n) / 3);
+						_reg->PC = c.NNN;
+					}
+					return n;
+				}
+				default:
+					return 0;
+			}
+		}
+
+		// Runs the slot's sequence when it fits in left, else one instruction
+		// through the core. Returns the instruction count.
+		int Dispatch (eFuse kind, uint16_t pc, int left) {
+			if (kind > FUSE_STORE && left >= Length(kind) && _cpu->state) {
+				const int n = Execute(kind, pc, left);
+				if (n) {
+					_cpu->cycle += n;
+					hits[kind]++;
+					covered[kind] += n;
+					return n;
+				}
+			}
+			if (kind == FUSE_STORE || kind == FUSE_BCD_LOAD) {
+				const sOpcode op(Word(pc, 0));
+				Invalidate(_reg->I, op.NN == 0x33 ? 3 : op.X + 1);
+			}
+			_cpu->Run();
+			return 1;
+		}
+
+		void Sync () {
+			if (generation != _cpu->generation) {
+				Flush();
+				generation = _cpu->generation;
+			}
+		}
+		uint8_t Slot (uint16_t pc) {
+			if (table[pc] == FUSE_UNKNOWN) {
+				table[pc] = Match(pc);
+			}
+			return table[pc];
+		}
+
+	public:
+		cFusion () {};
+		cFusion (cCPU &cpu) : _cpu(&cpu), _reg(cpu._reg), _mem(cpu._mem), generation(cpu.generation - 1) {};
+
+		void Flush () {
+			std::memset(table, FUSE_UNKNOWN, sizeof table);
+		}
+
+		// One dispatch of at most left instructions: a fused sequence when one
+		// starts at PC and fits, otherwise cCPU::Run. Returns the instruction
+		// count, which is what cycle advanced by.
+		int Step (int left) {
+			Sync();
+			const uint16_t pc = _reg->PC & MEM_MASK;
+			return Dispatch((eFuse) Slot(pc), pc, left);
+		}
+
+		// cCPU::RunUntil through the fused handlers. Plain instructions stay
+		// in this loop; only the rest go through Dispatch.
+		void RunUntil (long int end) {
+			Sync();
+			while (_cpu->cycle < end && _cpu->state) {
+				const uint16_t pc = _reg->PC & MEM_MASK;
+				const uint8_t kind = Slot(pc);
+				if (kind == FUSE_NONE) {
+					_cpu->Run();
+				} else {
+					Dispatch((eFuse) kind, pc, end - _cpu->cycle);
+				}
+			}
+		}
+
+		// cCPU::RunFrame through the fused handlers.
+		void RunFrame (int budget = INST_PER_SEC / 60) {
+			RunUntil(_cpu->cycle - _cpu->cycle % budget + budget);
+			_cpu->LatchInputs();
+		}
+
+		// The most instructions a sequence of this kind can run; for the idle
+		// kinds, the fewest one pass needs.
+		static int Length (int kind) {
+			static const int lengths[FUSE_KINDS] = {1, 1, 1, 3, 2, 3, 2, 1, 1, 3};
+			return lengths[kind];
+		}
+		static const char* Name (int kind) {
+			const char* const names[FUSE_KINDS] = {"", "", "", "font+draw", "bcd+load", "count loop", "skip+jump",
+												   "spin", "key wait", "delay wait"};
+			return names[kind];
+		}
+		long int Hits (int kind) const {
+			return hits[kind];
+		}
+		// Instructions run inside fused handlers, over all kinds.
+		long int Covered () const {
+			long int total = 0;
+			for (int k = FUSE_FONT_DRAW; k < FUSE_KINDS; ++k) {
+				total += covered[k];
+			}
+			return total;
+		}
+		long int Covered (int kind) const {
+			return covered[kind];
+		}
+};
+
+#endif
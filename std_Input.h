@@ -0,0 +1,136 @@
+#pragma once
+
+#ifndef InputCommon
+#define InputCommon
+
+#include <SDL2/SDL.h>
+#include <fstream>
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+#define KEY_UNBOUND 0xFF
+
+// Routes SDL key events straight into the keypad and keeps track of how long
+// a key press waits before the frame that follows it reaches the screen.
+class cInput {
+	private:
+		uint8_t		bindings[SDL_NUM_SCANCODES];
+
+		// Netplay owns the keypad: bound keys are collected here instead.
+		bool		detached = false;
+		uint16_t	held{};
+		uint16_t	pressed{};
+
+		bool		pending = false;
+		uint32_t	pending_since{};
+		uint32_t	samples{};
+		uint64_t	total_ms{};
+		uint32_t	max_ms{};
+
+	public:
+		cInput () {
+			DefaultBindings();
+		}
+
+		// The original layout: 1234 / QWER / ASDF / ZXCV map to keys 0-F in order.
+		void DefaultBindings () {
+			const SDL_Scancode key_map[16] = {SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4,
+											  SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_R,
+											  SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_F,
+											  SDL_SCANCODE_Z, SDL_SCANCODE_X, SDL_SCANCODE_C, SDL_SCANCODE_V};
+			std::memset(bindings, KEY_UNBOUND, sizeof bindings);
+			for (int i = 0; i < 16; ++i) {
+				bindings[key_map[i]] = i;
+			}
+		}
+
+		void Bind (SDL_Scancode scancode, uint8_t key) {
+			bindings[scancode] = key & 0x0F;
+		}
+
+		// One binding per line: "<SDL scancode name> <hex key>", '#' starts a comment.
+		bool LoadBindings (const char* path) {
+			std::ifstream in(path);
+			if (!in) {
+				return false;
+			}
+			std::memset(bindings, KEY_UNBOUND, sizeof bindings);
+			std::string line;
+			while (std::getline(in, line)) {
+				line = line.substr(0, line.find('#'));
+				std::istringstream fields(line);
+				std::string name;
+				unsigned int key;
+				if (!(fields >> name >> std::hex >> key)) {
+					continue;
+				}
+				const SDL_Scancode scancode = SDL_GetScancodeFromName(name.c_str());
+				if (scancode == SDL_SCANCODE_UNKNOWN || key > 0xF) {
+					nDebug::LogError("Ignoring key binding: " + line);
+					continue;
+				}
+				Bind(scancode, key);
+			}
+			return true;
+		}
+
+		// Returns true when the event was a bound keypad key.
+		bool HandleEvent (const SDL_Event &e, cCPU &cpu) {
+			if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+				return false;
+			}
+			const uint8_t key = bindings[e.key.keysym.scancode];
+			if (key == KEY_UNBOUND) {
+				return false;
+			}
+			if (e.type == SDL_KEYDOWN) {
+				if (e.key.repeat) {
+					return true;
+				}
+				if (!pending) {
+					pending = true;
+					pending_since = e.key.timestamp;
+				}
+			}
+			if (detached) {
+				const uint16_t bit = 1 << key;
+				held = (e.type == SDL_KEYDOWN) ? (held | bit) : (held & ~bit);
+				pressed |= (e.type == SDL_KEYDOWN) ? bit : 0;
+			} else {
+				cpu.SetKey(key, e.type == SDL_KEYDOWN);
+			}
+			return true;
+		}
+
+		void Detach (bool detach) {
+			detached = detach;
+		}
+		// Keys held now or pressed since the last call, one bit per key.
+		uint16_t Sample () {
+			const uint16_t keys = held | pressed;
+			pressed = 0;
+			return keys;
+		}
+
+		// Call right after the frame is presented.
+		void FramePresented () {
+			if (!pending) {
+				return;
+			}
+			const uint32_t latency = SDL_GetTicks() - pending_since;
+			pending = false;
+			samples++;
+			total_ms += latency;
+			max_ms = std::max(max_ms, latency);
+		}
+
+		void PrintStats () const {
+			if (samples == 0) {
+				return;
+			}
+			nDebug::LogInfo("Input-to-present latency over ", samples, " presses: avg ", total_ms / samples, " ms");
+			nDebug::LogInfo("Input-to-present latency max ", max_ms, " ms");
+		}
+};
+
+#endif
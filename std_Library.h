@@ -0,0 +1,285 @@
+#pragma once
+
+#ifndef LibraryCommon
+#define LibraryCommon
+
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Rom.h"
+
+#define LIBRARY_CACHE	"chip8.lib"
+#define LIBRARY_MAGIC	"chip8-library 2"
+
+// One ROM file, by absolute path. title, author and year come from the file
+// name; hash is the same FNV-1a the config's [rom <hash>] sections are keyed
+// on.
+struct sRomEntry {
+	std::string	path;
+	uint64_t	hash{};
+	uint64_t	size{};
+	int64_t		mtime{};
+	std::string	title;
+	std::string	author;
+	std::string	year;
+};
+
+// The .ch8 / .c8 files under a set of directories. The index is cached on
+// disk by path with each file's size and modification time, so a rescan
+// only stats files and reads the ones that are new or have changed.
+//
+// Rescans run on a worker thread against a copy of the index. Entries is
+// only replaced on the caller's thread, by Poll, so whatever shows the list
+// keeps the cached one until the scan is done.
+class cLibrary {
+	private:
+		std::vector<sRomEntry>	entries;
+		bool					dirty = false;
+
+		std::thread				worker;
+		std::atomic<bool>		finished = false;
+		std::atomic<bool>		cancel = false;
+		std::vector<sRomEntry>	scanned;
+		int						read = 0;
+
+		static bool IsRom (const std::filesystem::path &path) {
+			std::string ext = path.extension().string();
+			std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+			return ext == ".ch8" || ext == ".c8";
+		}
+
+		static std::string Lower (const std::string &s) {
+			std::string out = s;
+			std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+			return out;
+		}
+
+		static bool Same (const sRomEntry &a, const sRomEntry &b) {
+			return a.path == b.path && a.hash == b.hash && a.size == b.size && a.mtime == b.mtime;
+		}
+
+		static bool Under (const std::filesystem::path &path, const std::filesystem::path &dir) {
+			return std::mismatch(dir.begin(), dir.end(), path.begin(), path.end()).first == dir.end();
+		}
+
+		// The index after rescanning dirs: every file found under them, with
+		// the hash from known when its size and time are unchanged, plus the
+		// known entries outside all of them, which were not looked at.
+		static std::vector<sRomEntry> Index (const std::vector<sRomEntry> &known, const std::vector<std::string> &dirs,
+											 int &hashed, const std::atomic<bool> &cancel) {
+			std::vector<std::filesystem::path> roots;
+			for (const std::string &dir : dirs) {
+				std::filesystem::path root = Absolute(dir);
+				roots.push_back(root.filename().empty() ? root.parent_path() : root);
+			}
+			std::map<std::string, sRomEntry> cached;
+			std::vector<sRomEntry> out;
+			for (const sRomEntry &e : known) {
+				const std::filesystem::path path(e.path);
+				if (std::any_of(roots.begin(), roots.end(), [&](const std::filesystem::path &root) { return Under(path, root); })) {
+					cached[e.path] = e;
+				} else {
+					out.push_back(e);
+				}
+			}
+			std::set<std::string> found;
+			hashed = 0;
+			for (const std::filesystem::path &root : roots) {
+				std::error_code ec;
+				const auto options = std::filesystem::directory_options::skip_permission_denied;
+				auto it = std::filesystem::recursive_directory_iterator(root, options, ec);
+				if (ec) {
+					// Unreadable for now (unmounted, say): keep what was known.
+					for (const auto &[path, e] : cached) {
+						if (Under(path, root) && found.insert(path).second) {
+							out.push_back(e);
+						}
+					}
+					continue;
+				}
+				for (; it != std::filesystem::recursive_directory_iterator() && !cancel; it.increment(ec)) {
+					if (ec || !it->is_regular_file(ec) || !IsRom(it->path())) {
+						continue;
+					}
+					sRomEntry e;
+					e.path = it->path().lexically_normal().string();
+					e.size = it->file_size(ec);
+					e.mtime = it->last_write_time(ec).time_since_epoch().count();
+					if (!found.insert(e.path).second) {
+						continue;	// already found under an overlapping directory
+					}
+					const auto hit = cached.find(e.path);
+					if (hit != cached.end() && hit->second.size == e.size && hit->second.mtime == e.mtime) {
+						e.hash = hit->second.hash;
+					} else {
+						std::vector<uint8_t> image;
+						if (!nRom::Read(e.path.c_str(), image)) {
+							continue;
+						}
+						e.hash = nHash::Fnv1a(image.data(), image.size());
+						hashed++;
+					}
+					ParseName(it->path().stem().string(), e.title, e.author, e.year);
+					out.push_back(e);
+				}
+			}
+			std::sort(out.begin(), out.end(), [](const sRomEntry &a, const sRomEntry &b) {
+				const std::string la = Lower(a.title), lb = Lower(b.title);
+				return la != lb ? la < lb : a.path < b.path;
+			});
+			return out;
+		}
+
+	public:
+		cLibrary () {};
+		~cLibrary () {
+			cancel = true;
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+
+		// "Title [Author, Year]", "Title [Author]" or just "Title". The year
+		// is the last comma-separated field when it starts with a digit, so
+		// "199x" counts.
+		static void ParseName (const std::string &stem, std::string &title, std::string &author, std::string &year) {
+			title = stem;
+			author.clear();
+			year.clear();
+			const size_t open = stem.rfind('[');
+			if (open == std::string::npos || stem.back() != ']') {
+				return;
+			}
+			std::string meta = stem.substr(open + 1, stem.size() - open - 2);
+			title = stem.substr(0, stem.find_last_not_of(' ', open - 1) + 1);
+			const size_t comma = meta.rfind(',');
+			if (comma != std::string::npos) {
+				const size_t begin = meta.find_first_not_of(' ', comma + 1);
+				if (begin != std::string::npos && std::isdigit((unsigned char) meta[begin])) {
+					year = meta.substr(begin);
+					meta.erase(comma);
+				}
+			} else if (!meta.empty() && std::isdigit((unsigned char) meta[0])) {
+				year = meta;
+				meta.clear();
+			}
+			author = meta;
+		}
+
+		bool LoadCache (const char* path) {
+			std::ifstream in(path);
+			std::string line;
+			if (!in || !std::getline(in, line) || line != LIBRARY_MAGIC) {
+				return false;
+			}
+			entries.clear();
+			while (std::getline(in, line)) {
+				sRomEntry e;
+				unsigned long long hash, size;
+				long long mtime;
+				int n = 0;
+				if (sscanf(line.c_str(), "%llx %llu %lld %n", &hash, &size, &mtime, &n) < 3 || n == 0) {
+					continue;
+				}
+				e.path = line.substr(n);
+				e.hash = hash;
+				e.size = size;
+				e.mtime = mtime;
+				ParseName(std::filesystem::path(e.path).stem().string(), e.title, e.author, e.year);
+				entries.push_back(e);
+			}
+			dirty = false;
+			return true;
+		}
+
+		// Only writes when a scan has changed the index since the last load or save.
+		bool SaveCache (const char* path) {
+			if (!dirty) {
+				return true;
+			}
+			FILE* f = fopen(path, "w");
+			if (!f) {
+				return false;
+			}
+			fprintf(f, "%s\n", LIBRARY_MAGIC);
+			for (const sRomEntry &e : entries) {
+				fprintf(f, "%016llx %llu %lld %s\n", (unsigned long long) e.hash, (unsigned long long) e.size,
+						(long long) e.mtime, e.path.c_str());
+			}
+			fclose(f);
+			dirty = false;
+			return true;
+		}
+
+		// Starts rescanning dirs on the worker thread; false while one is
+		// still running.
+		bool StartScan (const std::vector<std::string> &dirs) {
+			if (worker.joinable()) {
+				return false;
+			}
+			finished = false;
+			worker = std::thread([this, known = entries, dirs] {
+				scanned = Index(known, dirs, read, cancel);
+				finished = true;
+			});
+			return true;
+		}
+		bool Scanning () const {
+			return worker.joinable();
+		}
+
+		// Takes a finished scan's result. Returns true when one was taken,
+		// whether or not it changed anything.
+		bool Poll () {
+			if (!worker.joinable() || !finished) {
+				return false;
+			}
+			worker.join();
+			if (!std::equal(entries.begin(), entries.end(), scanned.begin(), scanned.end(), Same)) {
+				entries.swap(scanned);
+				dirty = true;
+			}
+			scanned.clear();
+			return true;
+		}
+		// Files the last finished scan had to read.
+		int Read () const {
+			return read;
+		}
+
+		static std::filesystem::path Absolute (const std::filesystem::path &path) {
+			std::error_code ec;
+			const std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+			return (ec ? path : absolute).lexically_normal();
+		}
+
+		// Indices of the entries whose title, author or year contain filter,
+		// ignoring case.
+		std::vector<int> Find (const std::string &filter) const {
+			const std::string needle = Lower(filter);
+			std::vector<int> found;
+			for (size_t i = 0; i < entries.size(); ++i) {
+				const sRomEntry &e = entries[i];
+				if (needle.empty() || Lower(e.title + " " + e.author + " " + e.year).find(needle) != std::string::npos) {
+					found.push_back(i);
+				}
+			}
+			return found;
+		}
+
+		const std::vector<sRomEntry>& Entries () const {
+			return entries;
+		}
+		size_t Size () const {
+			return entries.size();
+		}
+};
+
+#endif
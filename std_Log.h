@@ -0,0 +1,208 @@
+#pragma once
+
+#ifndef LogCommon
+#define LogCommon
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+#define LOG_QUEUE	1024
+#define LOG_LINE	192
+#define LOG_RATE	2000	// records per second before non-error lines are dropped
+
+enum eLogLevel : uint8_t {
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARN,
+	LOG_ERROR,
+};
+
+struct sLogRecord {
+	eLogLevel	level{};
+	uint16_t	len{};
+	uint64_t	micros{};
+	char		text[LOG_LINE] {};
+};
+
+// Fixed-size line that callers format into. Each thread owns one, so building
+// a message never allocates and never touches shared stream state.
+struct sLogLine {
+	char	text[LOG_LINE];
+	size_t	len = 0;
+
+	sLogLine& Str (std::string_view s) {
+		const size_t n = std::min(s.size(), sizeof text - len);
+		std::memcpy(&text[len], s.data(), n);
+		len += n;
+		return *this;
+	}
+	sLogLine& Int (long long v) {
+		len += std::max(0, std::snprintf(&text[len], sizeof text - len, "%lld", v));
+		len = std::min(len, sizeof text - 1);
+		return *this;
+	}
+	sLogLine& Hex (uint32_t v, int width) {
+		len += std::max(0, std::snprintf(&text[len], sizeof text - len, "%0*x", width, v));
+		len = std::min(len, sizeof text - 1);
+		return *this;
+	}
+};
+
+// Background log writer. Callers copy a finished line into a bounded ring
+// and return; timestamps, formatting of the prefix and all I/O happen on the
+// writer thread. A full ring or an exhausted rate budget drops the line and
+// the writer reports how many went missing.
+class cLogger {
+	private:
+		sLogRecord*				queue{};
+		int						head = 0;
+		int						count = 0;
+		std::mutex				lock;
+		std::condition_variable	wake;
+		std::condition_variable	drained;
+		std::thread				worker;
+		bool					stopping = false;
+		bool					writing = false;
+
+		// Read by every Submit without the lock, and changed by SetLevel from
+		// whichever thread applies the config.
+		std::atomic<eLogLevel>	level{LOG_INFO};
+		uint32_t	dropped = 0;
+		double		tokens = LOG_RATE;
+		uint64_t	refilled{};
+
+		// Taken during static initialisation, so timestamps count from process
+		// start rather than from the first line logged.
+		static inline const std::chrono::steady_clock::time_point	epoch = std::chrono::steady_clock::now();
+
+		static uint64_t Micros () {
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+		}
+
+		void Worker () {
+			sLogRecord* batch = new sLogRecord[LOG_QUEUE];
+			while (true) {
+				int n = 0;
+				uint32_t missed;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					writing = false;
+					drained.notify_all();
+					wake.wait(guard, [this] { return count > 0 || dropped > 0 || stopping; });
+					if (count == 0 && dropped == 0) {
+						break;
+					}
+					for (; count > 0; ++n, --count, head = (head + 1) % LOG_QUEUE) {
+						batch[n] = queue[head];
+					}
+					missed = dropped;
+					dropped = 0;
+					writing = true;
+				}
+				for (int i = 0; i < n; ++i) {
+					Write(batch[i]);
+				}
+				if (missed) {
+					std::fprintf(stderr, "[%12.6f] W %u log lines dropped\n", Micros() / 1e6, missed);
+				}
+				std::fflush(stdout);
+				std::fflush(stderr);
+			}
+			delete[] batch;
+		}
+
+		void Write (const sLogRecord &r) const {
+			static const char tags[] = "DIWE";
+			FILE* out = (r.level >= LOG_WARN) ? stderr : stdout;
+			std::fprintf(out, "[%12.6f] %c %.*s\n", r.micros / 1e6, tags[r.level], (int) r.len, r.text);
+		}
+
+	public:
+		cLogger () {
+			queue = new sLogRecord[LOG_QUEUE];
+			worker = std::thread(&cLogger::Worker, this);
+		}
+		~cLogger () {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			wake.notify_one();
+			worker.join();
+			delete[] queue;
+		}
+
+		void SetLevel (eLogLevel level) {
+			this->level.store(level, std::memory_order_relaxed);
+		}
+		bool Enabled (eLogLevel level) const {
+			return level >= this->level.load(std::memory_order_relaxed);
+		}
+
+		static bool ParseLevel (const char* name, eLogLevel &level) {
+			const char* const names[] = {"debug", "info", "warn", "error"};
+			for (int i = 0; i < 4; ++i) {
+				if (std::strcmp(name, names[i]) == 0) {
+					level = (eLogLevel) i;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void Submit (eLogLevel level, const sLogLine &line) {
+			if (!Enabled(level)) {
+				return;
+			}
+			const uint64_t now = Micros();
+			std::lock_guard<std::mutex> guard(lock);
+			tokens = std::min<double>(LOG_RATE, tokens + (now - refilled) * (LOG_RATE / 1e6));
+			refilled = now;
+			if (count == LOG_QUEUE || (level < LOG_ERROR && tokens < 1)) {
+				dropped++;
+				wake.notify_one();
+				return;
+			}
+			tokens -= 1;
+			sLogRecord &r = queue[(head + count) % LOG_QUEUE];
+			r.level = level;
+			r.micros = now;
+			r.len = line.len;
+			std::memcpy(r.text, line.text, line.len);
+			count++;
+			wake.notify_one();
+		}
+
+		// Blocks until everything submitted so far has been written.
+		void Flush () {
+			std::unique_lock<std::mutex> guard(lock);
+			wake.notify_one();
+			drained.wait(guard, [this] { return (count == 0 && dropped == 0 && !writing) || stopping; });
+		}
+};
+
+namespace nLog
+{
+	inline cLogger& Logger () {
+		static cLogger logger;
+		return logger;
+	}
+
+	// The calling thread's scratch line, emptied.
+	inline sLogLine& Line () {
+		thread_local sLogLine line;
+		line.len = 0;
+		return line;
+	}
+}
+
+#endif
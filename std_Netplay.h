@@ -0,0 +1,378 @@
+#pragma once
+
+#ifndef NetplayCommon
+#define NetplayCommon
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <chrono>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+#define NET_MAGIC		0x504E3843	// "C8NP"
+#define NET_WINDOW		64			// frames of input and snapshots kept, power of two
+#define NET_MAX_PREDICT	8			// frames we may run past the last known remote input
+#define NET_MAX_DELAY	8
+#define NET_CHECK_EVERY	16			// frames between state checksums
+#define NET_CHECKS		8
+#define NET_SHIM_SLOTS	256
+#define NET_SEED		0x43384E50
+
+// One datagram per host frame each way. inputs[] holds the sender's keypad
+// for frames start .. start + count - 1, always beginning at the oldest frame
+// the receiver has not acknowledged, so a lost packet is covered by the next.
+struct sNetPacket {
+	uint32_t	magic;
+	uint32_t	ack;			// we hold the receiver's inputs for every frame below this
+	uint64_t	rom;			// both peers must run the same image
+	uint32_t	start;
+	uint32_t	count;
+	uint32_t	check_frame;	// state checksum of a confirmed frame, 0 if none yet
+	uint32_t	pad;
+	uint64_t	check_hash;
+	uint16_t	inputs[NET_WINDOW];
+};
+
+// Two-player rollback over UDP. Each peer runs its own core; only keypad
+// masks cross the wire and the machine sees both players' keys OR'd together.
+//
+// Every frame runs with the local input (delayed by a few frames to hide
+// most of the round trip) and the remote input, which is predicted to repeat
+// the last one received. Each simulated frame starts from a snapshot; when
+// a late remote input differs from the prediction, the core is restored to
+// that frame and the frames since are run again. A peer that gets
+// NET_MAX_PREDICT frames ahead of what it has heard waits for the other.
+//
+// net_latency / net_jitter / net_loss hold outgoing packets back, reorder
+// and drop them, to exercise all of this between two processes on one host.
+class cNetplay {
+	private:
+		struct sCheck {
+			uint32_t	frame;
+			uint64_t	hash;
+		};
+		struct sDelayed {
+			double		due;
+			uint16_t	len;
+			uint8_t		data[sizeof(sNetPacket)];
+		};
+
+		int					fd = -1;
+		sockaddr_storage	peer{};
+		socklen_t			peer_len{};
+		uint64_t			rom{};
+		int					budget = INST_PER_SEC / 60;
+		uint32_t			delay = 2;
+
+		sSnapshot	snap[NET_WINDOW];
+		uint16_t	local[NET_WINDOW] {};
+		uint16_t	remote[NET_WINDOW] {};
+		uint16_t	used[NET_WINDOW] {};	// remote input each frame was last simulated with
+		uint32_t	frame = 0;				// next frame to simulate
+		uint32_t	local_next = 0;			// local inputs are recorded below this
+		uint32_t	remote_known = 0;		// remote inputs are known below this
+		uint32_t	peer_ack = 0;
+		uint32_t	rollback_to = UINT32_MAX;
+		uint16_t	pending = 0;			// local keys seen while stalled
+
+		sCheck		own[NET_CHECKS] {};
+		sCheck		theirs[NET_CHECKS] {};
+		uint32_t	next_check = NET_CHECK_EVERY;
+		uint32_t	last_compared = 0;
+
+		double		latency_ms = 0;
+		double		jitter_ms = 0;
+		double		loss = 0;
+		sDelayed	shim[NET_SHIM_SLOTS];
+		bool		shim_used[NET_SHIM_SLOTS] {};
+		uint32_t	shim_rng = NET_SEED;
+
+		uint32_t	rollbacks{};
+		uint32_t	resimulated{};
+		uint32_t	max_depth{};
+		uint32_t	stalls{};
+		double		resim_us{};
+		double		max_resim_us{};
+		uint32_t	checks{};
+		uint32_t	desyncs{};
+		bool		rom_warned = false;
+
+		static double Now () {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		double Uniform () {
+			shim_rng ^= shim_rng << 13;
+			shim_rng ^= shim_rng >> 17;
+			shim_rng ^= shim_rng << 5;
+			return (shim_rng >> 8) / 16777216.0;
+		}
+
+		static uint64_t StateHash (const sSnapshot &s) {
+			uint64_t h = nHash::Fnv1a(s.memory, sizeof s.memory);
+			h = nHash::Fnv1a(s.frame_buffer, sizeof s.frame_buffer, h);
+			h = nHash::Fnv1a(s.reg.V, sizeof s.reg.V, h);
+			const uint16_t scalars[4] = {s.reg.PC, s.reg.I, s.delay_timer, s.sound_timer};
+			return nHash::Fnv1a((const uint8_t*) scalars, sizeof scalars, h);
+		}
+
+		static void ApplyKeys (cCPU &cpu, uint16_t keys) {
+			for (uint16_t changed = keys ^ cpu.GetKeypad(); changed; changed &= changed - 1) {
+				const int key = __builtin_ctz(changed);
+				cpu.SetKey(key, (keys >> key) & 1);
+			}
+		}
+
+		void Simulate (cCPU &cpu, uint32_t g) {
+			cpu.SaveState(snap[g % NET_WINDOW]);
+			const uint16_t r = (g < remote_known) ? remote[g % NET_WINDOW]
+							 : (remote_known ? remote[(remote_known - 1) % NET_WINDOW] : 0);
+			used[g % NET_WINDOW] = r;
+			ApplyKeys(cpu, local[g % NET_WINDOW] | r);
+			cpu.RunFrame(budget);
+		}
+
+		void Rollback (cCPU &cpu) {
+			const auto start = std::chrono::steady_clock::now();
+			cpu.LoadState(snap[rollback_to % NET_WINDOW]);
+			for (uint32_t g = rollback_to; g < frame; ++g) {
+				Simulate(cpu, g);
+			}
+			const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			rollbacks++;
+			resimulated += frame - rollback_to;
+			max_depth = std::max(max_depth, frame - rollback_to);
+			resim_us += us;
+			max_resim_us = std::max(max_resim_us, us);
+			rollback_to = UINT32_MAX;
+		}
+
+		void Compare (uint32_t slot) {
+			if (own[slot].frame && own[slot].frame == theirs[slot].frame && own[slot].frame > last_compared) {
+				last_compared = own[slot].frame;
+				checks++;
+				if (own[slot].hash != theirs[slot].hash) {
+					desyncs++;
+					nDebug::LogWarn(nDebug::ConvertToString("Netplay desync at frame 0x", own[slot].frame, ""));
+				}
+			}
+		}
+
+		// Snapshots below both frame and remote_known can no longer change.
+		void Checksum () {
+			while (next_check < frame && next_check <= remote_known) {
+				const uint32_t slot = (next_check / NET_CHECK_EVERY) % NET_CHECKS;
+				own[slot] = {next_check, StateHash(snap[next_check % NET_WINDOW])};
+				Compare(slot);
+				next_check += NET_CHECK_EVERY;
+			}
+		}
+
+		void Receive () {
+			sNetPacket p;
+			ssize_t n;
+			while ((n = recv(fd, &p, sizeof p, MSG_DONTWAIT)) > 0) {
+				if (n < (ssize_t) offsetof(sNetPacket, inputs) || p.magic != NET_MAGIC || p.count > NET_WINDOW
+					|| n < (ssize_t) (offsetof(sNetPacket, inputs) + p.count * sizeof(uint16_t))) {
+					continue;
+				}
+				if (p.rom != rom) {
+					if (!rom_warned) {
+						nDebug::LogError("Netplay peer is running a different ROM");
+						rom_warned = true;
+					}
+					continue;
+				}
+				peer_ack = std::max(peer_ack, std::min(p.ack, local_next));
+				for (uint32_t i = 0; i < p.count; ++i) {
+					const uint32_t g = p.start + i;
+					if (g != remote_known) {
+						continue;
+					}
+					remote[g % NET_WINDOW] = p.inputs[i];
+					if (g < frame && used[g % NET_WINDOW] != p.inputs[i]) {
+						rollback_to = std::min(rollback_to, g);
+					}
+					remote_known++;
+				}
+				if (p.check_frame) {
+					const uint32_t slot = (p.check_frame / NET_CHECK_EVERY) % NET_CHECKS;
+					theirs[slot] = {p.check_frame, p.check_hash};
+					Compare(slot);
+				}
+			}
+		}
+
+		void Transmit (const void* data, size_t len) {
+			sendto(fd, data, len, MSG_DONTWAIT, (const sockaddr*) &peer, peer_len);
+		}
+
+		void Send () {
+			sNetPacket p;
+			p.magic = NET_MAGIC;
+			p.ack = remote_known;
+			p.rom = rom;
+			p.start = peer_ack;
+			p.count = std::min<uint32_t>(local_next - peer_ack, NET_WINDOW);
+			for (uint32_t i = 0; i < p.count; ++i) {
+				p.inputs[i] = local[(p.start + i) % NET_WINDOW];
+			}
+			const sCheck &c = own[((next_check / NET_CHECK_EVERY) + NET_CHECKS - 1) % NET_CHECKS];
+			p.check_frame = c.frame;
+			p.pad = 0;
+			p.check_hash = c.hash;
+			const size_t len = offsetof(sNetPacket, inputs) + p.count * sizeof(uint16_t);
+
+			if (latency_ms == 0 && jitter_ms == 0 && loss == 0) {
+				Transmit(&p, len);
+				return;
+			}
+			if (Uniform() < loss) {
+				return;
+			}
+			for (int i = 0; i < NET_SHIM_SLOTS; ++i) {
+				if (!shim_used[i]) {
+					shim_used[i] = true;
+					shim[i].due = Now() + latency_ms + Uniform() * jitter_ms;
+					shim[i].len = len;
+					std::memcpy(shim[i].data, &p, len);
+					return;
+				}
+			}
+		}
+
+		void FlushShim () {
+			const double now = Now();
+			for (int i = 0; i < NET_SHIM_SLOTS; ++i) {
+				if (shim_used[i] && shim[i].due <= now) {
+					Transmit(shim[i].data, shim[i].len);
+					shim_used[i] = false;
+				}
+			}
+		}
+
+	public:
+		cNetplay () {};
+		~cNetplay () {
+			if (fd >= 0) {
+				close(fd);
+			}
+		}
+
+		// peer_addr is "host:port". Seeds the core so both sides draw the same
+		// random numbers; call after the ROM is loaded and before frame 0.
+		bool Open (cCPU &cpu, uint64_t rom_hash, int port, const std::string &peer_addr, int frame_budget, int input_delay) {
+			const size_t colon = peer_addr.rfind(':');
+			if (colon == std::string::npos) {
+				return false;
+			}
+			addrinfo hints{};
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_DGRAM;
+			addrinfo* res = nullptr;
+			if (getaddrinfo(peer_addr.substr(0, colon).c_str(), peer_addr.substr(colon + 1).c_str(), &hints, &res) != 0) {
+				return false;
+			}
+			std::memcpy(&peer, res->ai_addr, res->ai_addrlen);
+			peer_len = res->ai_addrlen;
+			freeaddrinfo(res);
+
+			sockaddr_in addr{};
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			addr.sin_port = htons(port);
+			fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0 || bind(fd, (const sockaddr*) &addr, sizeof addr) < 0) {
+				if (fd >= 0) {
+					close(fd);
+				}
+				fd = -1;
+				return false;
+			}
+
+			rom = rom_hash;
+			budget = frame_budget;
+			cpu.SetTimerPeriod(budget);
+			delay = std::clamp(input_delay, 0, NET_MAX_DELAY);
+			local_next = delay;
+			cpu.Seed(NET_SEED);
+			return true;
+		}
+
+		// Packet shim settings: fixed latency plus up to jitter extra, both in
+		// ms, and the fraction of packets dropped.
+		void SetShim (double latency, double jitter, double drop) {
+			latency_ms = std::max(0.0, latency);
+			jitter_ms = std::max(0.0, jitter);
+			loss = std::clamp(drop, 0.0, 1.0);
+		}
+
+		bool Active () const {
+			return fd >= 0;
+		}
+		uint32_t FrameNo () const {
+			return frame;
+		}
+		// Frames whose inputs from both players are final.
+		uint32_t Confirmed () const {
+			return std::min(frame, remote_known);
+		}
+
+		// Exchanges packets and repairs mispredictions without advancing.
+		void Poll (cCPU &cpu) {
+			FlushShim();
+			Receive();
+			if (rollback_to < frame) {
+				Rollback(cpu);
+			}
+			Checksum();
+			Send();
+		}
+
+		// One host frame: local is the keypad mask the player held (or tapped)
+		// since the last call. Runs one frame unless too far ahead of the peer
+		// or the core is paused.
+		void Frame (cCPU &cpu, uint16_t local_keys) {
+			FlushShim();
+			Receive();
+			if (rollback_to < frame) {
+				Rollback(cpu);
+			}
+			pending |= local_keys;
+			if (frame >= remote_known + NET_MAX_PREDICT) {
+				stalls++;
+			} else if (cpu.GetState()) {
+				local[local_next % NET_WINDOW] = pending;
+				local_next++;
+				pending = 0;
+				Simulate(cpu, frame);
+				frame++;
+			}
+			Checksum();
+			Send();
+		}
+
+		void PrintStats () const {
+			if (!Active()) {
+				return;
+			}
+			char line[192];
+			snprintf(line, sizeof line, "Netplay: %u frames, %u stalls, %u rollbacks resimulating %u frames (max %u)",
+					 frame, stalls, rollbacks, resimulated, max_depth);
+			nDebug::LogInfo(line);
+			snprintf(line, sizeof line, "Netplay rollback cost: avg %.0f us, max %.0f us; %u checksums compared, %u desyncs",
+					 rollbacks ? resim_us / rollbacks : 0.0, max_resim_us, checks, desyncs);
+			nDebug::LogInfo(line);
+		}
+		uint32_t Desyncs () const {
+			return desyncs;
+		}
+		uint32_t Checks () const {
+			return checks;
+		}
+};
+
+#endif
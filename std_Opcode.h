@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef OpcodeCommon
+#define OpcodeCommon
+
+#include <cstdint>
+
+// Field split shared by cCPU::Decode and the static tools, so every consumer
+// sees an instruction the same way the core does.
+struct sOpcode {
+	uint16_t	instr{};
+	uint16_t	NNN{};
+	uint8_t		NN{};
+	uint8_t		N{};
+	uint8_t		X{};
+	uint8_t		Y{};
+
+	sOpcode () {};
+	sOpcode (uint16_t instr) : instr(instr) {
+		NNN = instr & 0x0FFF;
+		NN = NNN & 0x00FF;
+		N = NN & 0x0F;
+		X = (NNN >> 8) & 0x0F;
+		Y = (NNN >> 4) & 0x0F;
+	}
+};
+
+#endif
@@ -0,0 +1,213 @@
+#pragma once
+
+#ifndef PickerCommon
+#define PickerCommon
+
+#include <SDL2/SDL.h>
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Config.h"
+#include "std_Library.h"
+
+// The picker draws into its own canvas, 4x the CHIP-8 display so it fills
+// the same area of the window, in 4x6 character cells.
+#define PICKER_WIDTH	(DISP_WIDTH * 4)
+#define PICKER_HEIGHT	(DISP_HEIGHT * 4)
+#define PICKER_COLS		(PICKER_WIDTH / 4)
+#define PICKER_LIST		18		// list rows between the header and the detail line
+#define PICKER_LIST_Y	9
+#define PICKER_DETAIL_Y	(PICKER_LIST_Y + PICKER_LIST * 6 + 3)
+
+// In-window ROM launcher over a cLibrary: type to filter, arrows and page
+// keys to move, Enter to load, Escape to close. While it is open it takes
+// every key event, so none reach the keypad.
+class cPicker {
+	private:
+		const cLibrary*		_library{};
+		const cConfig*		_config{};
+		bool				open = false;
+		std::string			filter;
+		std::vector<int>	shown;
+		int					selected = 0;
+		int					top = 0;
+		std::vector<uint32_t>	canvas;
+
+		// 3x5 glyphs for ASCII 32-95, one octal digit per row, top row first.
+		// Lower case draws as upper case and anything else as '?'.
+		static uint16_t Glyph (char c) {
+			static const uint16_t glyphs[64] = {
+				0,      022202, 055000, 057575, 036736, 051245, 025253, 022000,		//  !"#$%&'
+				012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244,		// ()*+,-./
+				075557, 026227, 071747, 071317, 055711, 074717, 074757, 071122,		// 01234567
+				075757, 075717, 002020, 002024, 012421, 007070, 042124, 071302,		// 89:;<=>?
+				025743, 025755, 065656, 034443, 065556, 074647, 074644, 034553,		// @ABCDEFG
+				055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552,		// HIJKLMNO
+				065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775,		// PQRSTUVW
+				055255, 055222, 071247, 064446, 044211, 031113, 025000, 000007,		// XYZ[\]^_
+			};
+			if (c >= 'a' && c <= 'z') {
+				c -= 'a' - 'A';
+			}
+			return (c >= 32 && c < 96) ? glyphs[c - 32] : glyphs['?' - 32];
+		}
+
+		void Fill (int x, int y, int w, int h, uint32_t color) {
+			for (int j = std::max(0, y); j < std::min(PICKER_HEIGHT, y + h); ++j) {
+				std::fill(canvas.begin() + j * PICKER_WIDTH + std::max(0, x),
+						  canvas.begin() + j * PICKER_WIDTH + std::min(PICKER_WIDTH, x + w), color);
+			}
+		}
+
+		// Text in the cell row starting at pixel y, cut off at max characters.
+		void Text (int col, int y, const std::string &s, uint32_t color, int max = PICKER_COLS) {
+			for (int i = 0; i < (int) s.size() && i < max && col + i < PICKER_COLS; ++i) {
+				const uint16_t glyph = Glyph(s[i]);
+				for (int j = 0; j < 5; ++j) {
+					for (int x = 0; x < 3; ++x) {
+						if (glyph >> ((4 - j) * 3 + 2 - x) & 1) {
+							canvas[(y + j) * PICKER_WIDTH + (col + i) * 4 + x + 1] = color;
+						}
+					}
+				}
+			}
+		}
+
+		void Refilter () {
+			shown = _library->Find(filter);
+			selected = std::clamp(selected, 0, std::max(0, (int) shown.size() - 1));
+			Scroll();
+		}
+		void Move (int step) {
+			selected = std::clamp(selected + step, 0, std::max(0, (int) shown.size() - 1));
+			Scroll();
+		}
+		void Scroll () {
+			top = std::clamp(top, std::max(0, selected - PICKER_LIST + 1), selected);
+		}
+		void Select (const std::string &path) {
+			if (path.empty()) {
+				return;
+			}
+			const std::string absolute = cLibrary::Absolute(path).string();
+			for (size_t i = 0; i < shown.size(); ++i) {
+				if (_library->Entries()[shown[i]].path == absolute) {
+					selected = i;
+				}
+			}
+		}
+
+	public:
+		cPicker () {};
+		cPicker (const cLibrary &library, const cConfig &config) : _library(&library), _config(&config),
+																	canvas(PICKER_WIDTH * PICKER_HEIGHT) {};
+
+		// Opens on the entry for path when the library has it.
+		void Open (const std::string &path) {
+			open = true;
+			filter.clear();
+			shown = _library->Find(filter);
+			selected = top = 0;
+			Select(path);
+			top = std::max(0, selected - PICKER_LIST / 2);
+			Scroll();
+			SDL_StartTextInput();
+		}
+		// After the library changed under it; the selection stays on the
+		// same ROM when it is still listed.
+		void Refresh () {
+			const std::string current = shown.empty() ? "" : _library->Entries()[shown[selected]].path;
+			shown = _library->Find(filter);
+			Select(current);
+			Move(0);
+		}
+		void Close () {
+			open = false;
+			SDL_StopTextInput();
+		}
+		bool Active () const {
+			return open;
+		}
+
+		// Returns true when the event was the picker's. pick is set to the
+		// chosen ROM's path when Enter closes it.
+		bool HandleEvent (const SDL_Event &e, std::string &pick) {
+			if (!open) {
+				return false;
+			}
+			if (e.type == SDL_TEXTINPUT) {
+				for (const char* c = e.text.text; *c; ++c) {
+					if (*c >= 32 && *c < 127) {
+						filter += *c;
+					}
+				}
+				Refilter();
+				return true;
+			}
+			// Key releases still go through, so nothing stays held on the keypad.
+			if (e.type != SDL_KEYDOWN) {
+				return false;
+			}
+			switch (e.key.keysym.sym) {
+				case (SDLK_ESCAPE):		Close(); break;
+				case (SDLK_UP):			Move(-1); break;
+				case (SDLK_DOWN):		Move(1); break;
+				case (SDLK_PAGEUP):		Move(-PICKER_LIST); break;
+				case (SDLK_PAGEDOWN):	Move(PICKER_LIST); break;
+				case (SDLK_HOME):		Move(-selected); break;
+				case (SDLK_END):		Move(shown.size()); break;
+				case (SDLK_BACKSPACE):
+					if (!filter.empty()) {
+						filter.pop_back();
+						Refilter();
+					}
+					break;
+				case (SDLK_RETURN):
+					if (!shown.empty()) {
+						pick = _library->Entries()[shown[selected]].path;
+						Close();
+					}
+					break;
+			}
+			return true;
+		}
+
+		// Header with the filter, the list with the selection inverted, and
+		// the selected ROM's hash and [rom] settings at the bottom.
+		const uint32_t* Render (uint32_t fg, uint32_t bg) {
+			std::fill(canvas.begin(), canvas.end(), bg);
+			char header[80];
+			snprintf(header, sizeof header, "%zu/%zu ROMS%s  FIND: ", shown.size(), _library->Size(),
+					 _library->Scanning() ? " (SCANNING)" : "");
+			Text(0, 1, header + filter + "_", fg);
+			Fill(0, PICKER_LIST_Y - 2, PICKER_WIDTH, 1, fg);
+			for (int r = 0; r < PICKER_LIST && top + r < (int) shown.size(); ++r) {
+				const sRomEntry &e = _library->Entries()[shown[top + r]];
+				const bool at = (top + r == selected);
+				const int y = PICKER_LIST_Y + r * 6;
+				if (at) {
+					Fill(0, y - 1, PICKER_WIDTH, 7, fg);
+				}
+				const uint32_t color = at ? bg : fg;
+				Text(0, y, e.title, color, 36);
+				Text(37, y, e.author, color, 21);
+				Text(PICKER_COLS - 4, y, e.year, color, 4);
+			}
+			if (!shown.empty()) {
+				const sRomEntry &e = _library->Entries()[shown[selected]];
+				char line[40];
+				snprintf(line, sizeof line, "[ROM %016llx]", (unsigned long long) e.hash);
+				std::string detail = line;
+				if (const std::vector<sSetting>* settings = _config->RomSettings(e.hash)) {
+					for (const sSetting &s : *settings) {
+						detail += " " + s.key + "=" + s.value;
+					}
+				}
+				Fill(0, PICKER_DETAIL_Y - 2, PICKER_WIDTH, 1, fg);
+				Text(0, PICKER_DETAIL_Y, detail, fg);
+			}
+			return canvas.data();
+		}
+};
+
+#endif
@@ -0,0 +1,364 @@
+#pragma once
+
+#ifndef RemoteCommon
+#define RemoteCommon
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <functional>
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+#define REMOTE_MAX_CLIENTS	8
+#define REMOTE_MAX_MESSAGE	512
+#define REMOTE_MAX_STEP		(1 << 24)
+
+// Wire protocol. Every message is an sRemoteHeader followed by len payload
+// bytes, little-endian, one message per SOCK_SEQPACKET datagram so there is
+// never a partial read or write to stitch together.
+enum eRemoteOp : uint8_t {
+	OP_LOAD = 1,	// path			-> MSG_ACK
+	OP_KEY,			// key, down	-> MSG_ACK
+	OP_STEP,		// u32 count	-> MSG_ACK; runs even while paused
+	OP_PAUSE,		// u8 paused	-> MSG_ACK; 1 pauses, 0 resumes, refused without the byte
+	OP_RESET,		//				-> MSG_ACK
+	OP_REGS,		//				-> MSG_REGS
+	OP_SUBSCRIBE,	// u8 mask		-> MSG_ACK, then MSG_FRAME / MSG_REGS every frame
+};
+
+enum eRemoteMsg : uint8_t {
+	MSG_ACK = 0x80,	// op, ok
+	MSG_REGS,		// sRemoteRegs
+	MSG_FRAME,		// u32 frame, u8 count, count x {u8 row, u64 xor}
+};
+
+#define REMOTE_FRAMES	1
+#define REMOTE_REGS		2
+
+struct sRemoteHeader {
+	uint8_t		type;
+	uint8_t		pad;
+	uint16_t	len;
+};
+
+struct sRemoteRegs {
+	uint64_t	cycle;
+	uint16_t	PC;
+	uint16_t	I;
+	uint8_t		V[16];
+	uint8_t		sp;
+	uint8_t		delay_timer;
+	uint8_t		sound_timer;
+	uint8_t		running;
+	uint8_t		fault;
+	uint8_t		pad[7];
+};
+static_assert(sizeof(sRemoteRegs) == 40, "sRemoteRegs is part of the wire format");
+
+// Each display row packs into one 64-bit word, pixel 0 in bit 63. A frame
+// message lists only the rows that changed, as XOR masks against the frame
+// before it; a keyframe is the same message against an empty screen.
+inline uint64_t PackRow (const uint8_t* row) {
+	uint64_t bits = 0;
+	for (int x = 0; x < DISP_WIDTH; ++x) {
+		bits = (bits << 1) | (row[x] & 1);
+	}
+	return bits;
+}
+
+// Drives a running emulator from a local Unix socket. Everything happens on
+// the caller's thread from Poll and Frame, so no locking is needed against
+// the core.
+class cRemote {
+	private:
+		struct sClient {
+			int		fd;
+			uint8_t	mask;
+			bool	keyframe;
+		};
+
+		int						listen_fd = -1;
+		std::string				path;
+		std::vector<sClient>	clients;
+
+		cCPU*		_cpu{};
+		sRegister*	_reg{};
+		bool		locked = false;
+		bool		empty = false;
+
+		uint64_t	rows[DISP_HEIGHT] {};
+		uint32_t	frame_no = 0;
+
+		// Encoded once per frame and handed to every subscriber as is.
+		uint8_t		diff[REMOTE_MAX_MESSAGE];
+		size_t		diff_len = 0;
+		uint8_t		key[REMOTE_MAX_MESSAGE];
+		size_t		key_len = 0;
+
+		static size_t Encode (uint8_t* out, uint8_t type, const void* payload, size_t len) {
+			const sRemoteHeader h {type, 0, (uint16_t) len};
+			std::memcpy(out, &h, sizeof h);
+			std::memcpy(out + sizeof h, payload, len);
+			return sizeof h + len;
+		}
+
+		static size_t EncodeFrame (uint8_t* out, uint32_t frame, const uint64_t* now, const uint64_t* before) {
+			uint8_t payload[5 + DISP_HEIGHT * 9];
+			std::memcpy(payload, &frame, 4);
+			size_t n = 5;
+			for (int y = 0; y < DISP_HEIGHT; ++y) {
+				const uint64_t x = now[y] ^ (before ? before[y] : 0);
+				if (x) {
+					payload[n] = y;
+					std::memcpy(&payload[n + 1], &x, 8);
+					n += 9;
+				}
+			}
+			payload[4] = (n - 5) / 9;
+			return Encode(out, MSG_FRAME, payload, n);
+		}
+
+		size_t EncodeRegs (uint8_t* out) const {
+			sRemoteRegs r {};
+			r.cycle = _cpu->GetCycle();
+			r.PC = _reg->PC;
+			r.I = _reg->I;
+			std::memcpy(r.V, _reg->V, sizeof r.V);
+			r.sp = _cpu->GetStackDepth();
+			r.delay_timer = _cpu->DelayTimer();
+			r.sound_timer = _cpu->SoundTimer();
+			r.running = _cpu->GetState();
+			r.fault = _cpu->GetFault();
+			return Encode(out, MSG_REGS, &r, sizeof r);
+		}
+
+		// False when the client is gone; a full socket buffer only loses this message.
+		bool Send (sClient &c, const uint8_t* buf, size_t len) {
+			if (send(c.fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t) len) {
+				return true;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				c.keyframe = true;
+				return true;
+			}
+			return false;
+		}
+
+		bool Ack (sClient &c, uint8_t op, bool ok) {
+			const uint8_t payload[2] = {op, ok};
+			uint8_t out[8];
+			return Send(c, out, Encode(out, MSG_ACK, payload, sizeof payload));
+		}
+
+		bool Handle (sClient &c, const uint8_t* msg, size_t len) {
+			sRemoteHeader h;
+			if (len < sizeof h) {
+				return false;
+			}
+			std::memcpy(&h, msg, sizeof h);
+			const uint8_t* p = msg + sizeof h;
+			if (h.len != len - sizeof h) {
+				return Ack(c, h.type, false);
+			}
+			if (locked && (h.type == OP_LOAD || h.type == OP_KEY || h.type == OP_STEP || h.type == OP_PAUSE
+						   || h.type == OP_RESET)) {
+				return Ack(c, h.type, false);
+			}
+			if (empty && (h.type == OP_KEY || h.type == OP_STEP || h.type == OP_PAUSE || h.type == OP_RESET)) {
+				return Ack(c, h.type, false);
+			}
+			switch (h.type) {
+				case (OP_LOAD):
+					return Ack(c, h.type, on_load && on_load(std::string((const char*) p, h.len)));
+				case (OP_KEY):
+					if (h.len < 2) {
+						return Ack(c, h.type, false);
+					}
+					_cpu->SetKey(p[0], p[1]);
+					return Ack(c, h.type, true);
+				case (OP_STEP): {
+					uint32_t count;
+					if (h.len < 4) {
+						return Ack(c, h.type, false);
+					}
+					std::memcpy(&count, p, 4);
+					const bool running = _cpu->GetState();
+					_cpu->SetState(true);
+					for (uint32_t i = 0; i < std::min<uint32_t>(count, REMOTE_MAX_STEP); ++i) {
+						_cpu->Run();
+					}
+					_cpu->SetState(running);
+					_cpu->Touch();
+					return Ack(c, h.type, true);
+				}
+				case (OP_PAUSE):
+					if (h.len < 1) {
+						return Ack(c, h.type, false);
+					}
+					_cpu->SetState(!p[0]);
+					return Ack(c, h.type, true);
+				case (OP_RESET):
+					_cpu->Reset();
+					if (on_reset) {
+						on_reset();
+					}
+					return Ack(c, h.type, true);
+				case (OP_REGS): {
+					uint8_t out[sizeof(sRemoteHeader) + sizeof(sRemoteRegs)];
+					return Send(c, out, EncodeRegs(out));
+				}
+				case (OP_SUBSCRIBE):
+					c.mask = h.len ? p[0] : 0;
+					c.keyframe = true;
+					return Ack(c, h.type, true);
+				default:
+					return Ack(c, h.type, false);
+			}
+		}
+
+	public:
+		// Called for OP_LOAD with the path; returns whether the ROM loaded.
+		std::function<bool (const std::string&)> on_load;
+		// Called after OP_RESET has reset the core.
+		std::function<void ()> on_reset;
+
+		cRemote (cCPU &cpu, sRegister &reg) : _cpu(&cpu), _reg(&reg) {};
+
+		// While locked, commands that would change the core are refused;
+		// under netplay every change has to go through the rollback timeline.
+		// Observing stays available.
+		void Lock (bool locked) {
+			this->locked = locked;
+		}
+		// With no ROM loaded there is nothing to run, step or reset; OP_LOAD
+		// is the only command that changes the core.
+		void SetEmpty (bool empty) {
+			this->empty = empty;
+		}
+		~cRemote () {
+			for (const sClient &c : clients) {
+				close(c.fd);
+			}
+			if (listen_fd >= 0) {
+				close(listen_fd);
+				unlink(path.c_str());
+			}
+		}
+
+		// A stale socket left at socket_path is replaced; any other file
+		// there makes this fail rather than be deleted.
+		bool Listen (const char* socket_path) {
+			sockaddr_un addr {};
+			addr.sun_family = AF_UNIX;
+			if (std::strlen(socket_path) >= sizeof addr.sun_path) {
+				return false;
+			}
+			struct stat st;
+			const bool exists = lstat(socket_path, &st) == 0;
+			if (exists && !S_ISSOCK(st.st_mode)) {
+				return false;
+			}
+			std::strcpy(addr.sun_path, socket_path);
+			listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (listen_fd < 0) {
+				return false;
+			}
+			if (exists) {
+				unlink(socket_path);
+			}
+			if (bind(listen_fd, (sockaddr*) &addr, sizeof addr) < 0 || listen(listen_fd, REMOTE_MAX_CLIENTS) < 0) {
+				close(listen_fd);
+				listen_fd = -1;
+				return false;
+			}
+			path = socket_path;
+			return true;
+		}
+
+		// Accepts new clients and serves every request already queued. Never blocks.
+		void Poll () {
+			if (listen_fd < 0) {
+				return;
+			}
+			int fd;
+			while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+				if (clients.size() == REMOTE_MAX_CLIENTS) {
+					close(fd);
+					continue;
+				}
+				clients.push_back({fd, 0, true});
+			}
+			for (size_t i = 0; i < clients.size(); ) {
+				uint8_t msg[REMOTE_MAX_MESSAGE];
+				bool alive = true;
+				ssize_t n = 1;
+				while (alive && (n = recv(clients[i].fd, msg, sizeof msg, MSG_DONTWAIT)) != 0) {
+					if (n < 0) {
+						alive = (errno == EAGAIN || errno == EWOULDBLOCK);
+						break;
+					}
+					alive = Handle(clients[i], msg, n);
+				}
+				if (!alive || n == 0) {
+					close(clients[i].fd);
+					clients.erase(clients.begin() + i);
+				} else {
+					++i;
+				}
+			}
+		}
+
+		// Streams the frame that is about to be presented to every subscriber.
+		void Frame (const uint8_t* disp) {
+			if (clients.empty()) {
+				return;
+			}
+			uint64_t now[DISP_HEIGHT];
+			for (int y = 0; y < DISP_HEIGHT; ++y) {
+				now[y] = PackRow(&disp[y * DISP_WIDTH]);
+			}
+			frame_no++;
+			diff_len = EncodeFrame(diff, frame_no, now, rows);
+			key_len = 0;
+			std::memcpy(rows, now, sizeof rows);
+			const bool changed = diff[sizeof(sRemoteHeader) + 4] != 0;
+
+			uint8_t regs[sizeof(sRemoteHeader) + sizeof(sRemoteRegs)];
+			size_t regs_len = 0;
+
+			for (size_t i = 0; i < clients.size(); ) {
+				sClient &c = clients[i];
+				bool alive = true;
+				if (c.mask & REMOTE_FRAMES) {
+					if (c.keyframe) {
+						if (key_len == 0) {
+							key_len = EncodeFrame(key, frame_no, now, nullptr);
+						}
+						c.keyframe = false;
+						alive = Send(c, key, key_len);
+					} else if (changed) {
+						alive = Send(c, diff, diff_len);
+					}
+				}
+				if (alive && (c.mask & REMOTE_REGS)) {
+					if (regs_len == 0) {
+						regs_len = EncodeRegs(regs);
+					}
+					alive = Send(c, regs, regs_len);
+				}
+				if (!alive) {
+					close(c.fd);
+					clients.erase(clients.begin() + i);
+				} else {
+					++i;
+				}
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef RomCommon
+#define RomCommon
+
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+
+namespace nRom
+{
+	// Reads a ROM image from disk. Anything past the end of the address
+	// space is cut off with a warning.
+	inline bool Read (const char* path, std::vector<uint8_t> &image) {
+		FILE* rom = fopen(path, "rb");
+		if (!rom) {
+			return false;
+		}
+		image.resize(MEM_SIZE - ROM_ENTRYPOINT + 1);
+		const size_t size = fread(image.data(), 1, image.size(), rom);
+		fclose(rom);
+		if (size > MEM_SIZE - ROM_ENTRYPOINT) {
+			nDebug::LogWarn(std::string(path) + " does not fit in memory; truncated");
+		}
+		image.resize(std::min<size_t>(size, MEM_SIZE - ROM_ENTRYPOINT));
+		return true;
+	}
+}
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef RunAheadCommon
+#define RunAheadCommon
+
+#include <chrono>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+#include "std_Cheat.h"
+
+#define RUNAHEAD_MAX	8
+
+// Hides the frames a ROM takes to react to a key. After each real frame the
+// machine is snapshotted, run ahead with the keypad as it stands, and the
+// screen from that future is what gets presented; then the snapshot is
+// restored so the real timeline never sees the speculative frames.
+class cRunAhead {
+	private:
+		sSnapshot	snap;
+		uint8_t		ahead[DISP_WIDTH * DISP_HEIGHT] {};
+		int			frames = 0;
+		int			budget = INST_PER_SEC / 60;
+
+		uint32_t	samples{};
+		double		total_us{};
+		double		max_us{};
+
+	public:
+		cRunAhead () {};
+
+		void Configure (int frames, int budget) {
+			this->frames = std::clamp(frames, 0, RUNAHEAD_MAX);
+			this->budget = budget;
+		}
+		int Frames () const {
+			return frames;
+		}
+
+		// Call once the real frame's instructions have run and inputs are
+		// latched. Returns the display to present:
+		// the run-ahead one, or disp itself when run-ahead is off or the core
+		// is not running. Active cheats are applied after every speculative
+		// instruction, as on the real timeline, so frozen values hold.
+		const uint8_t* Frame (cCPU &cpu, const uint8_t* disp, cCheats* cheats = nullptr) {
+			if (frames == 0 || !cpu.GetState()) {
+				return disp;
+			}
+			const auto start = std::chrono::steady_clock::now();
+			cpu.SaveState(snap);
+			for (int f = 0; f < frames; ++f) {
+				if (cheats && cheats->Active()) {
+					const long int end = cpu.GetCycle() - cpu.GetCycle() % budget + budget;
+					while (cpu.GetCycle() < end && cpu.GetState()) {
+						cpu.Run();
+						cheats->Apply();
+					}
+					cpu.LatchInputs();
+				} else {
+					cpu.RunFrame(budget);
+				}
+			}
+			std::memcpy(ahead, disp, sizeof ahead);
+			cpu.LoadState(snap);
+
+			const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			samples++;
+			total_us += us;
+			max_us = std::max(max_us, us);
+			return ahead;
+		}
+
+		void PrintStats (double frame_ms) const {
+			if (samples == 0) {
+				return;
+			}
+			const double avg_us = total_us / samples;
+			char line[128];
+			const int n = snprintf(line, sizeof line, "Run-ahead %d frames over %u frames: avg %.0f us, max %.0f us",
+								   frames, samples, avg_us, max_us);
+			if (frame_ms > 0) {
+				snprintf(line + n, sizeof line - n, " (%.2f%% of a %.2f ms frame)", avg_us / (frame_ms * 10), frame_ms);
+			}
+			nDebug::LogInfo(line);
+		}
+};
+
+#endif
@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef ScalerCommon
+#define ScalerCommon
+
+#include <vector>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+
+enum eFilter {
+    FILTER_NEAREST,
+    FILTER_OUTLINE,
+    FILTER_SMOOTH,
+    FILTER_SCALE2X,
+    FILTER_SCANLINE,
+    FILTER_CRT,
+};
+
+// CPU-side upscaler from the 64x32 bitmap into an RGBA8888 pixel buffer.
+// Every output cell depends only on the 3x3 neighbourhood around the source
+// pixel, so all 512 possible neighbourhoods are rendered into tiles once and
+// a frame is nothing but 2048 table lookups and row copies.
+class cScaler {
+    private:
+        int factor = 1;
+        uint32_t fg_col = FG_COLOR;
+        uint32_t bg_col = BG_COLOR;
+        std::vector<uint32_t> tiles;
+
+        // Neighbourhood bit layout: NW N NE / W C E / SW S SE, MSB first.
+        enum { NW = 8, N = 7, NE = 6, W = 5, C = 4, E = 3, SW = 2, S = 1, SE = 0 };
+
+        static bool Bit (int idx, int pos) {
+            return (idx >> pos) & 1;
+        }
+
+        static uint32_t Shade (uint32_t col, float r, float g, float b) {
+            const uint8_t cr = ((col >> 24) & 0xFF) * r;
+            const uint8_t cg = ((col >> 16) & 0xFF) * g;
+            const uint8_t cb = ((col >> 8) & 0xFF) * b;
+            return (cr << 24) | (cg << 16) | (cb << 8) | (col & 0xFF);
+        }
+
+        // Whether sub-pixel (i, j) of an f x f cell is lit for a given neighbourhood.
+        bool Covered (eFilter filter, int idx, int i, int j) const {
+            const bool on = Bit(idx, C);
+            switch (filter) {
+                case FILTER_OUTLINE:
+                    return on && i > 0 && j > 0 && i < factor - 1 && j < factor - 1;
+                case FILTER_SCALE2X: {
+                    // EPX: each quadrant copies a neighbour when the two edges meeting there agree.
+                    const bool n = Bit(idx, N), s = Bit(idx, S), w = Bit(idx, W), e = Bit(idx, E);
+                    const bool left = i < factor / 2, top = j < factor / 2;
+                    if (top && left) return (w == n && n != e && w != s) ? w : on;
+                    if (top)         return (n == e && n != w && e != s) ? e : on;
+                    if (left)        return (w == s && w != n && s != e) ? w : on;
+                    return (s == e && w != s && n != e) ? e : on;
+                }
+                case FILTER_SMOOTH: {
+                    // Cut a diagonal through every corner whose two edge neighbours agree with each other but not with the cell.
+                    const float u = (i + 0.5f) / factor, v = (j + 0.5f) / factor;
+                    const bool left = u < 0.5f, top = v < 0.5f;
+                    const bool a = Bit(idx, top ? N : S), b = Bit(idx, left ? W : E);
+                    const float du = left ? u : 1.0f - u, dv = top ? v : 1.0f - v;
+                    if (a == b && a != on && du + dv < 0.5f) {
+                        return a;
+                    }
+                    return on;
+                }
+                default:
+                    return on;
+            }
+        }
+
+        void BuildTiles (eFilter filter) {
+            const int area = factor * factor;
+            tiles.assign(512 * area, bg_col);
+            const int gap = std::max(1, factor / 4);
+
+            for (int idx = 0; idx < 512; ++idx) {
+                uint32_t* tile = &tiles[idx * area];
+                for (int j = 0; j < factor; ++j) {
+                    for (int i = 0; i < factor; ++i) {
+                        uint32_t col = Covered(filter, idx, i, j) ? fg_col : bg_col;
+                        if ((filter == FILTER_SCANLINE || filter == FILTER_CRT) && j >= factor - gap) {
+                            col = Shade(col, 0.45f, 0.45f, 0.45f);
+                        }
+                        if (filter == FILTER_CRT) {
+                            const float mask[3][3] = {{1.0f, 0.7f, 0.7f}, {0.7f, 1.0f, 0.7f}, {0.7f, 0.7f, 1.0f}};
+                            col = Shade(col, mask[i % 3][0], mask[i % 3][1], mask[i % 3][2]);
+                        }
+                        tile[j * factor + i] = col;
+                    }
+                }
+            }
+        }
+
+    public:
+        cScaler () {};
+
+        // Picks the largest integer factor that fits width x height and renders the tile table.
+        void Configure (int width, int height, eFilter filter, uint32_t fg, uint32_t bg) {
+            factor = std::max(1, std::min(width / DISP_WIDTH, height / DISP_HEIGHT));
+            fg_col = fg;
+            bg_col = bg;
+            BuildTiles(filter);
+        }
+
+        int Width () const {
+            return DISP_WIDTH * factor;
+        }
+        int Height () const {
+            return DISP_HEIGHT * factor;
+        }
+
+        // pixels must hold Width() * Height() entries.
+        void Render (const uint8_t* disp, uint32_t* pixels) const {
+            const int area = factor * factor;
+            const int pitch = Width();
+
+            for (int y = 0; y < DISP_HEIGHT; ++y) {
+                const uint8_t* up = (y > 0) ? &disp[(y - 1) * DISP_WIDTH] : nullptr;
+                const uint8_t* mid = &disp[y * DISP_WIDTH];
+                const uint8_t* down = (y < DISP_HEIGHT - 1) ? &disp[(y + 1) * DISP_WIDTH] : nullptr;
+
+                // Slide a three-column window across the row; each column is (up, mid, down).
+                auto column = [&](int x) -> int {
+                    if (x < 0 || x >= DISP_WIDTH) {
+                        return 0;
+                    }
+                    return ((up && up[x]) << 2) | ((mid[x] != 0) << 1) | (down && down[x]);
+                };
+                int left = 0, centre = column(0);
+                for (int x = 0; x < DISP_WIDTH; ++x) {
+                    const int right = column(x + 1);
+                    const int idx = ((left & 4) << 6) | ((centre & 4) << 5) | ((right & 4) << 4)
+                                  | ((left & 2) << 4) | ((centre & 2) << 3) | ((right & 2) << 2)
+                                  | ((left & 1) << 2) | ((centre & 1) << 1) | (right & 1);
+
+                    const uint32_t* tile = &tiles[idx * area];
+                    uint32_t* out = &pixels[(y * factor) * pitch + x * factor];
+                    for (int j = 0; j < factor; ++j) {
+                        std::memcpy(&out[j * pitch], &tile[j * factor], factor * sizeof *out);
+                    }
+                    left = centre;
+                    centre = right;
+                }
+            }
+        }
+
+        static bool ParseFilter (const char* name, eFilter &filter) {
+            const char* const names[] = {"nearest", "outline", "smooth", "scale2x", "scanline", "crt"};
+            for (int i = 0; i < 6; ++i) {
+                if (std::strcmp(name, names[i]) == 0) {
+                    filter = (eFilter) i;
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+#endif
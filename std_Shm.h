@@ -0,0 +1,150 @@
+#pragma once
+
+#ifndef ShmCommon
+#define ShmCommon
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_CPU.h"
+
+#define SHM_MAGIC	0x4D533843	// "C8SM"
+#define SHM_VERSION	1
+
+// Layout of the shared segment. seq is a seqlock: odd while the emulator is
+// writing, bumped to the next even value once the frame is complete.
+// Readers work in place and retry when seq moved under them; see nShm.
+struct alignas(64) sShmFrame {
+	uint32_t				magic;
+	uint32_t				version;
+	std::atomic<uint32_t>	seq;
+	uint32_t				frame;
+	uint64_t				cycle;
+	uint16_t				PC;
+	uint16_t				I;
+	uint8_t					V[16];
+	uint8_t					sp;
+	uint8_t					delay_timer;
+	uint8_t					sound_timer;
+	uint8_t					running;
+	uint8_t					fault;
+	uint8_t					pad;
+	uint16_t				keypad;		// bit n set while key n is down
+	alignas(64) uint8_t		frame_buffer[DISP_WIDTH * DISP_HEIGHT];
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seq must be usable across processes");
+
+namespace nShm
+{
+	// Consumer side, no syscalls once mapped:
+	//
+	//   uint32_t seq;
+	//   do {
+	//       seq = nShm::ReadBegin(*frame);
+	//       ... read fields straight out of *frame ...
+	//   } while (nShm::ReadRetry(*frame, seq));
+	inline uint32_t ReadBegin (const sShmFrame &f) {
+		uint32_t seq;
+		while ((seq = f.seq.load(std::memory_order_acquire)) & 1) {
+		}
+		return seq;
+	}
+	inline bool ReadRetry (const sShmFrame &f, uint32_t seq) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return f.seq.load(std::memory_order_relaxed) != seq;
+	}
+
+	// Maps an existing segment read-only; nullptr if it is missing or foreign.
+	inline const sShmFrame* Attach (const char* name) {
+		const int fd = shm_open(name, O_RDONLY, 0);
+		if (fd < 0) {
+			return nullptr;
+		}
+		void* p = mmap(nullptr, sizeof(sShmFrame), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) {
+			return nullptr;
+		}
+		const sShmFrame* f = (const sShmFrame*) p;
+		if (f->magic != SHM_MAGIC || f->version != SHM_VERSION) {
+			munmap(p, sizeof(sShmFrame));
+			return nullptr;
+		}
+		return f;
+	}
+}
+
+// Publishes the machine once per frame into a POSIX shared-memory segment.
+// Writing is a handful of stores and one 2 KB copy; the emulator never waits
+// for readers.
+class cShmExport {
+	private:
+		sShmFrame*	shm{};
+		std::string	name;
+
+		cCPU*		_cpu{};
+		sRegister*	_reg{};
+		uint8_t*	_disp{};
+
+	public:
+		cShmExport (cCPU &cpu, sRegister &reg, uint8_t* disp) : _cpu(&cpu), _reg(&reg), _disp(disp) {};
+		~cShmExport () {
+			if (shm) {
+				munmap(shm, sizeof *shm);
+				shm_unlink(name.c_str());
+			}
+		}
+
+		// name follows shm_open rules: a leading '/' and no other slashes.
+		bool Open (const char* shm_name) {
+			const int fd = shm_open(shm_name, O_RDWR | O_CREAT, 0644);
+			if (fd < 0) {
+				return false;
+			}
+			void* p = MAP_FAILED;
+			if (ftruncate(fd, sizeof(sShmFrame)) == 0) {
+				p = mmap(nullptr, sizeof(sShmFrame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			}
+			close(fd);
+			if (p == MAP_FAILED) {
+				shm_unlink(shm_name);
+				return false;
+			}
+			shm = (sShmFrame*) p;
+			name = shm_name;
+			shm->seq.store(0, std::memory_order_relaxed);
+			shm->version = SHM_VERSION;
+			shm->magic = SHM_MAGIC;
+			return true;
+		}
+
+		void Publish () {
+			if (!shm) {
+				return;
+			}
+			const uint32_t seq = shm->seq.load(std::memory_order_relaxed);
+			shm->seq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			shm->frame++;
+			shm->cycle = _cpu->GetCycle();
+			shm->PC = _reg->PC;
+			shm->I = _reg->I;
+			std::memcpy(shm->V, _reg->V, sizeof shm->V);
+			shm->sp = _cpu->GetStackDepth();
+			shm->delay_timer = _cpu->DelayTimer();
+			shm->sound_timer = _cpu->SoundTimer();
+			shm->running = _cpu->GetState();
+			shm->fault = _cpu->GetFault();
+			shm->keypad = _cpu->GetKeypad();
+			std::memcpy(shm->frame_buffer, _disp, sizeof shm->frame_buffer);
+
+			shm->seq.store(seq + 2, std::memory_order_release);
+		}
+};
+
+#endif
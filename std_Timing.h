@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef TimingCommon
+#define TimingCommon
+
+#include "std_Chip8Includes.h"
+#include "std_CommonIncludes.h"
+#include "std_Opcode.h"
+
+// A COSMAC VIP runs its 1802 at 1.7609 MHz, 8 clocks to a machine cycle:
+// 3668 machine cycles per 60 Hz frame. The 1861's display DMA takes 1024 of
+// them and the interrupt routine around 100, the interpreter gets the rest.
+#define VIP_CYCLES_PER_FRAME	(3668 - 1024 - 100)
+// Fetching an instruction and dispatching on its first nibble.
+#define VIP_FETCH				40
+
+// How cCPU counts cycle. TIMING_FLAT is one per instruction and a frame is
+// a fixed instruction budget. TIMING_VIP charges what each opcode costs the
+// VIP interpreter in machine cycles, and Dxyn waits for the next frame the
+// way the VIP's display interrupt makes it.
+enum eTiming {
+	TIMING_FLAT,
+	TIMING_VIP,
+};
+
+namespace nTiming
+{
+	inline bool ParseTiming (const char* name, eTiming &timing) {
+		const char* const names[] = {"flat", "vip"};
+		for (int i = 0; i < 2; ++i) {
+			if (std::strcmp(name, names[i]) == 0) {
+				timing = (eTiming) i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Approximate machine cycles one instruction takes on the VIP: the shared
+	// fetch plus the opcode's own routine. Loops in those routines are folded
+	// in from the opcode (rows drawn, registers moved); data-dependent paths
+	// such as a taken skip or a sprite straddling a byte boundary are not.
+	inline uint16_t VipCost (uint16_t instr) {
+		const sOpcode op(instr);
+		switch (instr >> 12) {
+			case (0x0):
+				if (instr == 0x00E0) {
+					return VIP_FETCH + 24 + 256 * 6;
+				}
+				return VIP_FETCH + 10;
+			case (0x1):	return VIP_FETCH + 12;
+			case (0x2):	return VIP_FETCH + 26;
+			case (0x3):
+			case (0x4):	return VIP_FETCH + 10;
+			case (0x5):
+			case (0x9):	return VIP_FETCH + 14;
+			case (0x6):	return VIP_FETCH + 6;
+			case (0x7):	return VIP_FETCH + 10;
+			case (0x8):	return VIP_FETCH + 44;
+			case (0xA):	return VIP_FETCH + 12;
+			case (0xB):	return VIP_FETCH + 22;
+			case (0xC):	return VIP_FETCH + 36;
+			case (0xD):	return VIP_FETCH + 26 + op.N * 46;
+			case (0xE):	return VIP_FETCH + 14;
+			case (0xF):
+				switch (op.NN) {
+					case (0x0A):	return VIP_FETCH + 18;
+					case (0x1E):
+					case (0x29):	return VIP_FETCH + 16;
+					case (0x33):	return VIP_FETCH + 84;
+					case (0x55):
+					case (0x65):	return VIP_FETCH + 14 + 14 * (op.X + 1);
+				}
+				return VIP_FETCH + 10;
+		}
+		return VIP_FETCH;
+	}
+
+	// VipCost for every opcode, built on first use, so the core only has to
+	// index it.
+	struct sVipTable {
+		uint16_t	cost[0x10000];
+
+		sVipTable () {
+			for (int i = 0; i < 0x10000; ++i) {
+				cost[i] = VipCost(i);
+			}
+		}
+	};
+	inline const uint16_t* VipTable () {
+		static const sVipTable table;
+		return table.cost;
+	}
+
+	// Every opcode costs one cycle: the table cCPU indexes with a zero mask.
+	inline const uint16_t FLAT_COST[1] = {1};
+}
+
+#endif